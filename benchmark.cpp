@@ -0,0 +1,1645 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "geoserver_curl_wrapper.hpp"
+#include "geoserver_internal.hpp"
+#include "geoserver_payload.hpp"
+#include "geoserver_async.hpp"
+#include "geoserver_batch.hpp"
+#include "geoserver_cluster.hpp"
+#include "geoserver_metrics.hpp"
+#include "geoserver_reconcile.hpp"
+#include "mock_geoserver.hpp"
+
+/** Benchmarks of "geoserver_curl_wrapper". They do not need running
+ * Geoserver. Run: ./benchmark [section] [key=value ...], where section is one of
+ * "catalog", "payload", "metrics", "e2e", "share". Without section, all benchmarks are run.
+ * "e2e" runs public API against local mock server ("mock_geoserver.hpp"), options:
+ *  threads=4 ops=2000 latency_ms=0 jitter_ms=0 layers=1000 error_rate=0
+ * "./benchmark mock port=8080 [...]" only runs mock server until killed.
+ * "h2" compares HTTP/1.1 and h2c through external h2c front proxy, "tls"
+ * measures HTTPS session cache and warm-up through external TLS front.
+ * They, "upload", "compression", "reconcile", "snapshot", "cluster",
+ * "replicas", "priority", "limiter" and "singleflight" are run only when
+ * selected, see README.
+ */
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ms(bench_clock::time_point from)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - from).count();
+}
+
+// Repeat "fn" until at least 200 ms passed, returns average ms per call
+template <typename F>
+static double measure_ms(F fn)
+{
+    fn(); // warm-up
+    int iterations = 0;
+    bench_clock::time_point start = bench_clock::now();
+    do
+    {
+        fn();
+        iterations++;
+    } while (elapsed_ms(start) < 200);
+    return elapsed_ms(start) / iterations;
+}
+
+// Catalog as returned by "/rest/layers.xml"
+static std::string make_layers_xml(int num_layers)
+{
+    std::string xml = "<layers>\n";
+    for (int i = 0; i < num_layers; i++)
+    {
+        char layer[512];
+        snprintf(layer, sizeof(layer),
+            "  <layer>\n"
+            "    <name>workspace%d:layer_%d</name>\n"
+            "    <atom:link xmlns:atom=\"http://www.w3.org/2005/Atom\" rel=\"alternate\" "
+            "href=\"http://localhost:8080/geoserver/rest/layers/workspace%d%%3Alayer_%d.xml\" "
+            "type=\"application/xml\"/>\n"
+            "  </layer>\n", i % 8, i, i % 8, i);
+        xml += layer;
+    }
+    xml += "</layers>";
+    return xml;
+}
+
+// Catalog as returned by "/rest/layers.json"
+static std::string make_layers_json(int num_layers)
+{
+    std::string json = "{\"layers\":{\"layer\":[";
+    for (int i = 0; i < num_layers; i++)
+    {
+        char layer[512];
+        snprintf(layer, sizeof(layer),
+            "%s{\"name\":\"workspace%d:layer_%d\",\"href\":\"http:\\/\\/localhost:8080"
+            "\\/geoserver\\/rest\\/layers\\/workspace%d%%3Alayer_%d.json\"}",
+            (i) ? "," : "", i % 8, i, i % 8, i);
+        json += layer;
+    }
+    json += "]}}";
+    return json;
+}
+
+static bool count_layer(const char* name, void* user_data)
+{
+    (*(size_t*)user_data)++;
+    return true;
+}
+
+static void bench_catalog()
+{
+    fprintf(stdout, "# catalog parsing: libxml2 DOM (layers.xml) vs JSON (layers.json)\n");
+    fprintf(stdout, "%10s %12s %12s %12s %12s %8s\n", "layers", "xml_bytes",
+        "xml_dom_ms", "json_bytes", "json_ms", "speedup");
+
+    const int sizes[] = {1000, 10000, 100000};
+    for (int num_layers : sizes)
+    {
+        std::string xml = make_layers_xml(num_layers);
+        std::string json = make_layers_json(num_layers);
+
+        size_t xml_count = 0;
+        size_t json_count = 0;
+        double xml_ms = measure_ms([&]
+        {
+            xml_count = 0;
+            geoserver_api::parse_layers_xml(xml.c_str(), xml.size(), NULL,
+                count_layer, &xml_count);
+        });
+        double json_ms = measure_ms([&]
+        {
+            json_count = 0;
+            geoserver_api::parse_layers_json(json.c_str(), json.size(), NULL,
+                count_layer, &json_count);
+        });
+        if (xml_count != (size_t)num_layers || json_count != (size_t)num_layers)
+        {
+            fprintf(stderr, "catalog parsing returned wrong number of layers\n");
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(stdout, "%10d %12zu %12.3f %12zu %12.3f %7.1fx\n", num_layers,
+            xml.size(), xml_ms, json.size(), json_ms, xml_ms / json_ms);
+    }
+}
+
+// Previous "create_layer()" body code, kept as reference
+static bool snprintf_create_layer_body(const char* layer_name, const char* layer_title,
+    const char* postgis_table_name, const char* filter, const bool advertised,
+    char* data, size_t data_size)
+{
+    const char* data_template = 
+    "<featureType>"
+        "<name>%s</name>"
+        "<nativeName>%s</nativeName>"
+        "<title>%s</title>"
+        "<srs>EPSG:3059</srs>"
+        "%s" // for filter tag
+        "<advertised>%s</advertised>"
+    "</featureType>";
+
+    int j = 0;
+    char filter_tag[512] = {0};
+    if (filter)
+    {
+        j = snprintf(filter_tag, sizeof(filter_tag), "<cqlFilter>%s</cqlFilter>", filter);
+    }
+    if (j < 0 || j >= (int)sizeof(filter_tag)) return false;
+
+    j = snprintf(data, data_size, data_template, layer_name, postgis_table_name,
+        layer_title, filter_tag, (advertised) ? "true" : "false");
+    return j >= 0 && j < (int)data_size;
+}
+
+// Former "prepare_layer_group()": guessed size and strcat loop, O(n^2)
+static char* strcat_layer_group(const char* workspace, const std::vector<std::string>& names)
+{
+    const char layer_template[] =
+        "<published type=\"layer\">"
+            "<name>%s:%s</name>"
+        "</published>";
+    size_t layer_size = (sizeof(layer_template) + 64) * names.size() + 1;
+    char single_layer[sizeof(layer_template) + 64] = {0};
+
+    char* layers = (char*)malloc(layer_size);
+    if (!layers) return NULL;
+    memset(layers, 0, layer_size);
+    for (const std::string& name : names)
+    {
+        snprintf(single_layer, sizeof(single_layer), layer_template, workspace, name.c_str());
+        strcat(layers, single_layer);
+    }
+    return layers;
+}
+
+static void bench_payload()
+{
+    fprintf(stdout, "# create_layer() body: snprintf into stack buffers vs payload builder\n");
+    fprintf(stdout, "%14s %10s %14s %14s\n", "filter_bytes", "body_bytes",
+        "snprintf_ns", "builder_ns");
+
+    const size_t filter_sizes[] = {0, 32, 400, 4000};
+    std::string body;
+    for (size_t filter_size : filter_sizes)
+    {
+        std::string filter;
+        while (filter.size() < filter_size) filter += "density > 99 AND ";
+        filter.resize(filter_size);
+        const char* filter_arg = (filter_size) ? filter.c_str() : NULL;
+
+        const int batch = 10000;
+        bool snprintf_ok = true;
+        double snprintf_ms = measure_ms([&]
+        {
+            for (int i = 0; i < batch; i++)
+            {
+                char data[1024] = {0};
+                snprintf_ok = snprintf_create_layer_body("example_layer1", "Example layer 1",
+                    "density_test", filter_arg, true, data, sizeof(data));
+            }
+        });
+        double builder_ms = measure_ms([&]
+        {
+            using geoserver_api::payload::lit;
+            namespace payload = geoserver_api::payload;
+            for (int i = 0; i < batch; i++)
+            {
+                payload::build(&body,
+                lit("<featureType><name>"), payload::xml{"example_layer1"},
+                lit("</name><nativeName>"), payload::xml{"density_test"},
+                lit("</nativeName><title>"), payload::xml{"Example layer 1"},
+                lit("</title><srs>EPSG:3059</srs><cqlFilter>"), payload::xml{filter_arg},
+                lit("</cqlFilter><advertised>"), payload::raw{"true"},
+                lit("</advertised></featureType>"));
+            }
+        });
+
+        char snprintf_ns[32] = "truncated";
+        if (snprintf_ok) snprintf(snprintf_ns, sizeof(snprintf_ns), "%.1f", snprintf_ms * 1e6 / batch);
+        fprintf(stdout, "%14zu %10zu %14s %14.1f\n", filter_size, body.size(),
+            snprintf_ns, builder_ms * 1e6 / batch);
+    }
+
+    fprintf(stdout, "# layer group structure: former strcat loop vs layer_group_builder\n");
+    fprintf(stdout, "%14s %14s %14s %14s\n", "layers", "bytes", "strcat_us", "builder_us");
+    const int group_sizes[] = {10, 300, 3000, 30000};
+    for (int num_layers : group_sizes)
+    {
+        std::vector<std::string> names;
+        for (int i = 0; i < num_layers; i++) names.push_back("basemap_layer_" + std::to_string(i));
+
+        double strcat_ms = measure_ms([&]
+        {
+            free(strcat_layer_group("workspace0", names));
+        });
+        geoserver_api::layer_group_builder layers;
+        double builder_ms = measure_ms([&]
+        {
+            layers.clear(); // Memory is reused, as in loop creating many groups
+            for (const std::string& name : names)
+            {
+                layers.add("workspace0", name.c_str(), "basemap", "workspace0");
+            }
+        });
+        fprintf(stdout, "%14d %14zu %14.1f %14.1f\n", num_layers, layers.publishables().size(),
+            strcat_ms * 1e3, builder_ms * 1e3);
+    }
+}
+
+// Value of "key=value" argument or "fallback"
+static double bench_arg(int argc, char** argv, const char* key, double fallback)
+{
+    size_t key_len = strlen(key);
+    for (int i = 2; i < argc; i++)
+    {
+        if (strncmp(argv[i], key, key_len) == 0 && argv[i][key_len] == '=')
+        {
+            return atof(argv[i] + key_len + 1);
+        }
+    }
+    return fallback;
+}
+
+// Value of "key=value" string argument or "fallback"
+static const char* bench_arg_str(int argc, char** argv, const char* key, const char* fallback)
+{
+    size_t key_len = strlen(key);
+    for (int i = 2; i < argc; i++)
+    {
+        if (strncmp(argv[i], key, key_len) == 0 && argv[i][key_len] == '=')
+        {
+            return argv[i] + key_len + 1;
+        }
+    }
+    return fallback;
+}
+
+static geoserver_mock::mock_options mock_args(int argc, char** argv)
+{
+    geoserver_mock::mock_options options;
+    options.port = (int)bench_arg(argc, argv, "port", 0);
+    options.latency_ms = (int)bench_arg(argc, argv, "latency_ms", 0);
+    options.latency_jitter_ms = (int)bench_arg(argc, argv, "jitter_ms", 0);
+    options.slow_rate = bench_arg(argc, argv, "slow_rate", 0);
+    options.slow_ms = (int)bench_arg(argc, argv, "slow_ms", 0);
+    options.load_latency_ms = (int)bench_arg(argc, argv, "load_latency_ms", 0);
+    options.max_concurrent = (int)bench_arg(argc, argv, "max_concurrent", 0);
+    options.num_layers = (int)bench_arg(argc, argv, "layers", 1000);
+    options.error_rate = bench_arg(argc, argv, "error_rate", 0);
+    options.reset_rate = bench_arg(argc, argv, "reset_rate", 0);
+    options.bandwidth_mbit = (int)bench_arg(argc, argv, "bandwidth_mbit", 0);
+    return options;
+}
+
+// Latencies of one operation, prints single result row
+struct op_report
+{
+    std::vector<double> latencies_ms;
+    int failed = 0;
+
+    // "end_line" false lets caller append more columns
+    void print(const char* name, double wall_ms, bool end_line=true)
+    {
+        std::sort(latencies_ms.begin(), latencies_ms.end());
+        size_t n = latencies_ms.size();
+        double p50 = (n) ? latencies_ms[n / 2] : 0;
+        double p99 = (n) ? latencies_ms[std::min(n - 1, n * 99 / 100)] : 0;
+        fprintf(stdout, "%-22s %8zu %8d %10.3f %10.3f %12.0f%s", name, n, failed,
+            p50, p99, n * 1000.0 / wall_ms, (end_line) ? "\n" : "");
+    }
+};
+
+// Run "fn(thread_index, op_index)" "ops" times spread over "threads" threads.
+// Operation failed if "fn" returned false or HTTP status code is not 2xx
+template <typename F>
+static void run_sync_op(const char* name, int threads, int ops, F fn, bool end_line=true)
+{
+    std::vector<op_report> reports(threads);
+    std::vector<std::thread> workers;
+    bench_clock::time_point start = bench_clock::now();
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]
+        {
+            for (int i = t; i < ops; i += threads)
+            {
+                bench_clock::time_point op_start = bench_clock::now();
+                bool ok = fn(t, i) && geoserver_api::get_http_response_code() / 100 == 2;
+                reports[t].latencies_ms.push_back(elapsed_ms(op_start));
+                if (!ok) reports[t].failed++;
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double wall_ms = elapsed_ms(start);
+
+    op_report total;
+    for (op_report& report : reports)
+    {
+        total.latencies_ms.insert(total.latencies_ms.end(),
+            report.latencies_ms.begin(), report.latencies_ms.end());
+        total.failed += report.failed;
+    }
+    total.print(name, wall_ms, end_line);
+}
+
+static void bench_e2e(int argc, char** argv)
+{
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    int threads = std::max((int)bench_arg(argc, argv, "threads", 4), 1);
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 2000), 1);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    if (!geoserver_api::init("127.0.0.1", server.port(), "admin", "geoserver", 5, threads))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "# end-to-end against mock server: threads=%d ops=%d latency_ms=%d "
+        "jitter_ms=%d layers=%d error_rate=%.3f\n", threads, ops, options.latency_ms,
+        options.latency_jitter_ms, options.num_layers, options.error_rate);
+    fprintf(stdout, "%-22s %8s %8s %10s %10s %12s\n", "operation", "ops", "failed",
+        "p50_ms", "p99_ms", "ops_per_s");
+
+    geoserver_api::metrics::reset();
+
+    // Reads first, so catalog size is "layers" for all of them
+    int list_ops = std::max(ops / 10, 1);
+    geoserver_api::set_catalog_format(geoserver_api::FORMAT_XML);
+    run_sync_op("get_layers(xml)", threads, list_ops, [](int, int)
+    {
+        geoserver_api::layer_list layers;
+        bool ok = geoserver_api::get_layers(NULL, &layers);
+        geoserver_api::free_layer_list(&layers);
+        return ok;
+    });
+    run_sync_op("get_layers_stream(xml)", threads, list_ops, [](int, int)
+    {
+        size_t count = 0;
+        return geoserver_api::get_layers_stream(NULL, count_layer, &count);
+    });
+    geoserver_api::set_catalog_format(geoserver_api::FORMAT_JSON);
+    run_sync_op("get_layers(json)", threads, list_ops, [](int, int)
+    {
+        geoserver_api::layer_list layers;
+        bool ok = geoserver_api::get_layers(NULL, &layers);
+        geoserver_api::free_layer_list(&layers);
+        return ok;
+    });
+    run_sync_op("get_layers(ws,json)", threads, list_ops, [](int, int)
+    {
+        geoserver_api::layer_list layers;
+        bool ok = geoserver_api::get_layers("workspace0", &layers);
+        geoserver_api::free_layer_list(&layers);
+        return ok;
+    });
+    geoserver_api::set_catalog_format(geoserver_api::FORMAT_XML);
+
+    run_sync_op("create_layer", threads, ops, [](int, int i)
+    {
+        std::string name = "bench_layer_" + std::to_string(i);
+        return geoserver_api::create_layer(name.c_str(), name.c_str(), "density_test",
+            "density > 99", "workspace0", "postgis", true);
+    });
+    run_sync_op("add_style", threads, ops, [](int, int i)
+    {
+        std::string name = "bench_layer_" + std::to_string(i);
+        return geoserver_api::add_style(name.c_str(), "density", "workspace0", "workspace0");
+    });
+    geoserver_api::layer_group_builder group_layers;
+    group_layers.add("workspace0", "bench_layer_0", "density", "workspace0");
+    group_layers.add("workspace0", "layer_0");
+    run_sync_op("create_layer_group", threads, ops, [&](int, int i)
+    {
+        std::string name = "bench_group_" + std::to_string(i);
+        return geoserver_api::create_layer_group(name.c_str(), name.c_str(), group_layers,
+            "workspace0", true);
+    });
+
+    // Async: all requests are submitted at once, latency includes queueing
+    {
+        namespace async = geoserver_api::async;
+        async::start();
+        std::vector<bench_clock::time_point> submitted(ops);
+        std::vector<std::future<async::response>> futures;
+        op_report report;
+        bench_clock::time_point start = bench_clock::now();
+        for (int i = 0; i < ops; i++)
+        {
+            std::string name = "bench_async_layer_" + std::to_string(i);
+            submitted[i] = bench_clock::now();
+            futures.push_back(async::create_layer(name.c_str(), name.c_str(),
+                "density_test", NULL, "workspace0", "postgis", true));
+        }
+        for (int i = 0; i < ops; i++)
+        {
+            async::response response = futures[i].get();
+            report.latencies_ms.push_back(elapsed_ms(submitted[i]));
+            if (!response.success || response.http_code / 100 != 2) report.failed++;
+        }
+        double wall_ms = elapsed_ms(start);
+        async::stop();
+        report.print("async::create_layer", wall_ms);
+    }
+
+    // Where time went, from per-request libcurl timing
+    {
+        namespace metrics = geoserver_api::metrics;
+        metrics::snapshot snap = metrics::get_snapshot();
+        fprintf(stdout, "# phase p50/p99 in ms from geoserver_api::metrics histograms\n");
+        fprintf(stdout, "%-20s %9s", "operation", "requests");
+        for (int ph = 0; ph < metrics::PHASE_COUNT; ph++)
+        {
+            fprintf(stdout, " %15s", metrics::phase_name((metrics::phase)ph));
+        }
+        fprintf(stdout, "\n");
+        for (int op = 0; op < metrics::OP_COUNT; op++)
+        {
+            const metrics::operation_stats& stats = snap.operations[op];
+            fprintf(stdout, "%-20s %9llu", metrics::operation_name((metrics::operation)op),
+                (unsigned long long)stats.requests);
+            for (int ph = 0; ph < metrics::PHASE_COUNT; ph++)
+            {
+                char cell[32];
+                snprintf(cell, sizeof(cell), "%.3f/%.3f",
+                    metrics::histogram_quantile(stats.phases[ph], 0.5) * 1e3,
+                    metrics::histogram_quantile(stats.phases[ph], 0.99) * 1e3);
+                fprintf(stdout, " %15s", cell);
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+
+    geoserver_api::cleanup();
+    server.stop();
+
+    geoserver_mock::mock_stats stats = server.stats();
+    fprintf(stdout, "# server: requests=%lu connections=%lu errors=%lu resets=%lu "
+        "bytes_in=%lu bytes_out=%lu\n", stats.requests, stats.connections, stats.errors,
+        stats.resets, stats.bytes_received, stats.bytes_sent);
+}
+
+// Cost of recording single request and of Prometheus export
+static void bench_metrics()
+{
+    namespace metrics = geoserver_api::metrics;
+    fprintf(stdout, "# metrics overhead\n");
+
+    CURL* handle = curl_easy_init();
+    const int batch = 100000;
+    double record_ms = measure_ms([&]
+    {
+        metrics::request_timing timing;
+        for (int i = 0; i < batch; i++)
+        {
+            geoserver_api::record_request(metrics::OP_CREATE_LAYER, handle, CURLE_OK,
+                201, &timing);
+        }
+    });
+    curl_easy_cleanup(handle);
+
+    std::string text;
+    double export_ms = measure_ms([&] { text = metrics::export_prometheus(); });
+    metrics::reset();
+
+    fprintf(stdout, "record_request: %.1f ns, export_prometheus: %.3f ms (%zu bytes)\n",
+        record_ms * 1e6 / batch, export_ms, text.size());
+}
+
+// Async requests over HTTP/1.1 and h2c through h2c-capable front proxy
+static void bench_h2(int argc, char** argv)
+{
+    namespace async = geoserver_api::async;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    if (!options.port) options.port = 18090;
+    options.latency_ms = (int)bench_arg(argc, argv, "latency_ms", 5);
+    int h2_port = (int)bench_arg(argc, argv, "h2_port", 3000);
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 2000), 1);
+    int concurrency = std::max((int)bench_arg(argc, argv, "concurrency", 64), 1);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+
+    fprintf(stdout, "# async create_layer via h2c front on port %d -> mock on port %d: "
+        "ops=%d concurrency=%d latency_ms=%d\n", h2_port, options.port, ops, concurrency,
+        options.latency_ms);
+    fprintf(stdout, "%-22s %8s %8s %10s %10s %12s %12s\n", "protocol", "ops", "failed",
+        "p50_ms", "p99_ms", "ops_per_s", "connections");
+
+    const geoserver_api::http_version versions[] = {geoserver_api::HTTP_1_1,
+        geoserver_api::HTTP_2, geoserver_api::HTTP_2_PRIOR_KNOWLEDGE};
+    const char* version_names[] = {"http/1.1", "h2c upgrade", "h2c prior knowledge"};
+    for (int v = 0; v < 3; v++)
+    {
+        geoserver_api::init_options init_options;
+        init_options.hostname = "127.0.0.1";
+        init_options.port = h2_port;
+        init_options.timeout_s = 10;
+        init_options.version = versions[v];
+        if (!geoserver_api::init(init_options) || !async::start(concurrency))
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        std::vector<bench_clock::time_point> submitted(ops);
+        std::vector<std::future<async::response>> futures;
+        op_report report;
+        int connections = 0;
+        bench_clock::time_point start = bench_clock::now();
+        for (int i = 0; i < ops; i++)
+        {
+            std::string name = "bench_h2_layer_" + std::to_string(v) + "_" + std::to_string(i);
+            submitted[i] = bench_clock::now();
+            futures.push_back(async::create_layer(name.c_str(), name.c_str(),
+                "density_test", NULL, "workspace0", "postgis", true));
+        }
+        for (int i = 0; i < ops; i++)
+        {
+            async::response response = futures[i].get();
+            report.latencies_ms.push_back(elapsed_ms(submitted[i]));
+            if (!response.success || response.http_code / 100 != 2) report.failed++;
+            if (response.timing.connect_s > 0) connections++; // 0 on reused connection
+        }
+        double wall_ms = elapsed_ms(start);
+        async::stop();
+        geoserver_api::cleanup();
+
+        std::sort(report.latencies_ms.begin(), report.latencies_ms.end());
+        size_t n = report.latencies_ms.size();
+        fprintf(stdout, "%-22s %8zu %8d %10.3f %10.3f %12.0f %12d\n", version_names[v], n,
+            report.failed, report.latencies_ms[n / 2],
+            report.latencies_ms[std::min(n - 1, n * 99 / 100)], n * 1000.0 / wall_ms,
+            connections);
+        if (report.failed == ops)
+        {
+            fprintf(stderr, "all requests failed, start h2c front first, e.g.:\n"
+                "  nghttpx -f'127.0.0.1,%d;no-tls' -b'127.0.0.1,%d' --backend-connections-per-host=%d\n",
+                h2_port, options.port, concurrency);
+            break;
+        }
+    }
+    server.stop();
+}
+
+// Burst of parallel requests after first request, with and without shared DNS cache
+static void bench_share(int argc, char** argv)
+{
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    const char* hostname = bench_arg_str(argc, argv, "hostname", "localhost");
+    int threads = std::max((int)bench_arg(argc, argv, "threads", 16), 1);
+    int rounds = std::max((int)bench_arg(argc, argv, "rounds", 50), 1);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+
+    fprintf(stdout, "# burst of %d parallel create_layer to %s after first request, %d rounds\n",
+        threads, hostname, rounds);
+    fprintf(stdout, "%-14s %10s %10s %12s %12s\n", "dns_cache", "p50_ms", "p99_ms",
+        "lookups", "dns_ms/req");
+
+    int name_counter = 0;
+    for (int shared = 0; shared < 2; shared++)
+    {
+        std::vector<double> latencies_ms;
+        double dns_ms = 0;
+        int lookups = 0;
+        for (int round = 0; round < rounds; round++)
+        {
+            geoserver_api::init_options init_options;
+            init_options.hostname = hostname;
+            init_options.port = server.port();
+            init_options.pool_size = threads;
+            init_options.share_dns_cache = shared;
+            if (!geoserver_api::init(init_options)) exit(EXIT_FAILURE);
+
+            // First request resolves hostname, burst follows
+            geoserver_api::create_layer("bench_share_seed", "seed", "density_test", NULL,
+                "workspace0", "postgis", true);
+
+            std::vector<std::thread> workers;
+            std::vector<double> burst_ms(threads);
+            std::vector<geoserver_api::metrics::request_timing> timings(threads);
+            for (int t = 0; t < threads; t++)
+            {
+                std::string name = "bench_share_layer_" + std::to_string(name_counter++);
+                workers.emplace_back([&, t, name]
+                {
+                    bench_clock::time_point start = bench_clock::now();
+                    geoserver_api::create_layer(name.c_str(), name.c_str(), "density_test",
+                        NULL, "workspace0", "postgis", true);
+                    burst_ms[t] = elapsed_ms(start);
+                    timings[t] = geoserver_api::metrics::get_last_request_timing();
+                });
+            }
+            for (std::thread& worker : workers) worker.join();
+            geoserver_api::cleanup();
+
+            for (int t = 0; t < threads; t++)
+            {
+                latencies_ms.push_back(burst_ms[t]);
+                dns_ms += timings[t].namelookup_s * 1e3;
+                if (timings[t].namelookup_s > 0.00005) lookups++; // cache hit is ~0
+            }
+        }
+
+        std::sort(latencies_ms.begin(), latencies_ms.end());
+        size_t n = latencies_ms.size();
+        fprintf(stdout, "%-14s %10.3f %10.3f %12d %12.3f\n", (shared) ? "shared" : "per handle",
+            latencies_ms[n / 2], latencies_ms[std::min(n - 1, n * 99 / 100)], lookups,
+            dns_ms / n);
+    }
+    server.stop();
+}
+
+static bool get_layers_op(int, int)
+{
+    geoserver_api::layer_list layers;
+    bool ok = geoserver_api::get_layers(NULL, &layers);
+    geoserver_api::free_layer_list(&layers);
+    return ok;
+}
+
+// get_layers against unreliable mock with retry policy, then against mock
+// with slow tail with hedging, each with feature off and on
+static void bench_retry(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    int threads = std::max((int)bench_arg(argc, argv, "threads", 4), 1);
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 1000), 1);
+
+    geoserver_mock::mock_options failing = mock_args(argc, argv);
+    failing.num_layers = (int)bench_arg(argc, argv, "layers", 200);
+    failing.latency_ms = (int)bench_arg(argc, argv, "latency_ms", 2);
+    failing.error_rate = bench_arg(argc, argv, "error_rate", 0.05);
+    failing.reset_rate = bench_arg(argc, argv, "reset_rate", 0.02);
+
+    geoserver_mock::mock_options slow = failing;
+    slow.port = 0;
+    slow.error_rate = 0;
+    slow.reset_rate = 0;
+    slow.slow_rate = bench_arg(argc, argv, "slow_rate", 0.03);
+    slow.slow_ms = (int)bench_arg(argc, argv, "slow_ms", 200);
+
+    fprintf(stdout, "# sync get_layers: threads=%d ops=%d latency_ms=%d error_rate=%.3f "
+        "reset_rate=%.3f, then slow_rate=%.3f slow_ms=%d\n", threads, ops,
+        failing.latency_ms, failing.error_rate, failing.reset_rate, slow.slow_rate,
+        slow.slow_ms);
+    fprintf(stdout, "%-22s %8s %8s %10s %10s %12s %8s %8s %8s\n", "policy", "ops",
+        "failed", "p50_ms", "p99_ms", "ops_per_s", "retries", "hedges", "wins");
+
+    struct policy_case
+    {
+        const char* name;
+        const geoserver_mock::mock_options* mock;
+        int max_attempts;
+        bool hedge;
+    };
+    const struct policy_case cases[] = {
+        {"no retry", &failing, 1, false},
+        {"retry x3", &failing, 3, false},
+        {"no hedge", &slow, 1, false},
+        {"hedge p95", &slow, 1, true},
+    };
+    for (const struct policy_case& c : cases)
+    {
+        geoserver_mock::mock_server server;
+        if (!server.start(*c.mock)) exit(EXIT_FAILURE);
+        // Spare handles for hedge requests
+        if (!init("127.0.0.1", server.port(), "admin", "geoserver", 5, threads * 2))
+        {
+            exit(EXIT_FAILURE);
+        }
+
+        struct retry_policy retry;
+        retry.max_attempts = c.max_attempts;
+        retry.base_delay_ms = 5;
+        retry.respect_retry_after = false; // mock asks for 1 s
+        set_retry_policy(retry);
+        struct hedge_policy hedge;
+        hedge.enabled = c.hedge;
+        set_hedge_policy(hedge);
+
+        // Latency history for hedge delay
+        for (int i = 0; i < hedge.min_samples; i++) get_layers_op(0, 0);
+        metrics::reset();
+
+        run_sync_op(c.name, threads, ops, get_layers_op, false);
+        struct metrics::operation_stats stats =
+            metrics::get_snapshot().operations[metrics::OP_GET_LAYERS];
+        fprintf(stdout, " %8llu %8llu %8llu\n", (unsigned long long)stats.retries,
+            (unsigned long long)stats.hedges, (unsigned long long)stats.hedge_wins);
+        cleanup();
+        server.stop();
+    }
+    set_retry_policy(geoserver_api::retry_policy());
+    set_hedge_policy(geoserver_api::hedge_policy());
+}
+
+// First burst of requests over HTTPS, with and without TLS session cache and warm-up
+static void bench_tls(int argc, char** argv)
+{
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    if (!options.port) options.port = 18090;
+    int tls_port = (int)bench_arg(argc, argv, "tls_port", 3443);
+    const char* ca_file = bench_arg_str(argc, argv, "ca_file", NULL);
+    int threads = std::max((int)bench_arg(argc, argv, "threads", 16), 1);
+    int rounds = std::max((int)bench_arg(argc, argv, "rounds", 20), 1);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+
+    fprintf(stdout, "# first burst of %d parallel create_layer over HTTPS (port %d), "
+        "%d rounds\n", threads, tls_port, rounds);
+    fprintf(stdout, "%-14s %8s %10s %10s %10s %14s\n", "session_cache", "warm_up",
+        "p50_ms", "p99_ms", "new_conns", "tls_ms/conn");
+
+    int name_counter = 0;
+    for (int variant = 0; variant < 4; variant++)
+    {
+        bool session_cache = variant & 1;
+        bool warm = variant & 2;
+        std::vector<double> latencies_ms;
+        int new_connections = 0;
+        double tls_ms = 0;
+        int failed = 0;
+        for (int round = 0; round < rounds; round++)
+        {
+            geoserver_api::init_options init_options;
+            init_options.hostname = "127.0.0.1";
+            init_options.port = tls_port;
+            init_options.pool_size = threads;
+            init_options.use_https = true;
+            init_options.ca_file = ca_file;
+            init_options.tls_session_cache = session_cache;
+            if (!geoserver_api::init(init_options)) exit(EXIT_FAILURE);
+
+            // Seed TLS session with single request
+            geoserver_api::create_layer("bench_tls_seed", "seed", "density_test", NULL,
+                "workspace0", "postgis", true);
+            if (warm) geoserver_api::warm_up(threads);
+
+            std::vector<std::thread> workers;
+            std::vector<double> burst_ms(threads);
+            std::vector<geoserver_api::metrics::request_timing> timings(threads);
+            std::vector<bool> ok(threads);
+            for (int t = 0; t < threads; t++)
+            {
+                std::string name = "bench_tls_layer_" + std::to_string(name_counter++);
+                workers.emplace_back([&, t, name]
+                {
+                    bench_clock::time_point start = bench_clock::now();
+                    ok[t] = geoserver_api::create_layer(name.c_str(), name.c_str(),
+                        "density_test", NULL, "workspace0", "postgis", true) &&
+                        geoserver_api::get_http_response_code() == 201;
+                    burst_ms[t] = elapsed_ms(start);
+                    timings[t] = geoserver_api::metrics::get_last_request_timing();
+                });
+            }
+            for (std::thread& worker : workers) worker.join();
+            geoserver_api::cleanup();
+
+            for (int t = 0; t < threads; t++)
+            {
+                latencies_ms.push_back(burst_ms[t]);
+                if (!ok[t]) failed++;
+                if (timings[t].connect_s > 0)
+                {
+                    new_connections++;
+                    tls_ms += (timings[t].pretransfer_s - timings[t].connect_s) * 1e3;
+                }
+            }
+        }
+
+        std::sort(latencies_ms.begin(), latencies_ms.end());
+        size_t n = latencies_ms.size();
+        fprintf(stdout, "%-14s %8s %10.3f %10.3f %10d %14.3f\n", (session_cache) ? "on" : "off",
+            (warm) ? "yes" : "no", latencies_ms[n / 2],
+            latencies_ms[std::min(n - 1, n * 99 / 100)], new_connections,
+            (new_connections) ? tls_ms / new_connections : 0.0);
+        if (failed == (int)n)
+        {
+            fprintf(stderr, "all requests failed, start TLS front first, e.g.:\n"
+                "  nghttpx -f'127.0.0.1,%d' -b'127.0.0.1,%d' key.pem cert.pem\n"
+                "and pass its certificate as ca_file=cert.pem\n", tls_port, options.port);
+            break;
+        }
+    }
+    server.stop();
+}
+
+// Anonymous (heap) resident memory, mapped file pages are not included
+static long rss_anon_mb()
+{
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), status))
+    {
+        if (sscanf(line, "RssAnon: %ld kB", &kb) == 1) break;
+    }
+    fclose(status);
+    return kb / 1024;
+}
+
+struct upload_progress
+{
+    int calls = 0;
+    long max_rss_anon_mb = 0;
+};
+
+static bool track_upload(uint64_t sent_bytes, uint64_t total_bytes, void* user_data)
+{
+    struct upload_progress* progress = (struct upload_progress*)user_data;
+    progress->calls++;
+    progress->max_rss_anon_mb = std::max(progress->max_rss_anon_mb, rss_anon_mb());
+    return true;
+}
+
+// Large layer list download and large layer group upload with compression
+// off and on, wire bytes are counted by mock server
+static void bench_compression(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    options.num_layers = (int)bench_arg(argc, argv, "layers", 100000);
+    options.bandwidth_mbit = (int)bench_arg(argc, argv, "bandwidth_mbit", 100);
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 10), 1);
+    int group_layers = std::max((int)bench_arg(argc, argv, "group_layers", 5000), 1);
+
+    layer_group_builder group;
+    for (int i = 0; i < group_layers; i++)
+    {
+        group.add("workspace0", ("layer_" + std::to_string(i)).c_str());
+    }
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+
+    fprintf(stdout, "# layers=%d bandwidth_mbit=%d ops=%d, layer group of %d layers "
+        "(%zu bytes)\n", options.num_layers, options.bandwidth_mbit, ops, group_layers,
+        group.publishables().size());
+    fprintf(stdout, "%-28s %8s %14s %10s %10s\n", "operation", "failed", "wire_kb/op",
+        "p50_ms", "p99_ms");
+
+    for (int compressed = 0; compressed < 2; compressed++)
+    {
+        init_options init_options;
+        init_options.port = server.port();
+        init_options.hostname = "127.0.0.1";
+        init_options.pool_size = 1;
+        init_options.accept_encoding = compressed;
+        init_options.gzip_request_min_bytes = (compressed) ? 1024 : 0;
+        if (!init(init_options)) exit(EXIT_FAILURE);
+
+        for (int read = 1; read >= 0; read--)
+        {
+            op_report report;
+            geoserver_mock::mock_stats before = server.stats();
+            for (int i = 0; i < ops; i++)
+            {
+                bench_clock::time_point start = bench_clock::now();
+                bool ok;
+                if (read)
+                {
+                    ok = get_layers_op(0, 0);
+                }
+                else
+                {
+                    std::string name = "bench_group_" + std::to_string(compressed) +
+                        "_" + std::to_string(i);
+                    ok = create_layer_group(name.c_str(), "group", group,
+                        "workspace0", true);
+                }
+                report.latencies_ms.push_back(elapsed_ms(start));
+                if (!ok || get_http_response_code() / 100 != 2) report.failed++;
+            }
+            geoserver_mock::mock_stats after = server.stats();
+            unsigned long wire_bytes = (read) ? after.bytes_sent - before.bytes_sent :
+                after.bytes_received - before.bytes_received;
+
+            std::sort(report.latencies_ms.begin(), report.latencies_ms.end());
+            size_t n = report.latencies_ms.size();
+            std::string name = std::string((read) ? "get_layers" : "create_layer_group") +
+                ((compressed) ? " (gzip)" : " (plain)");
+            fprintf(stdout, "%-28s %8d %14.1f %10.3f %10.3f\n", name.c_str(), report.failed,
+                wire_bytes / 1024.0 / ops, report.latencies_ms[n / 2],
+                report.latencies_ms[std::min(n - 1, n * 99 / 100)]);
+        }
+        cleanup();
+    }
+    server.stop();
+}
+
+// Streamed upload of generated file to mock, heap must not grow with file size
+static void bench_upload(int argc, char** argv)
+{
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    int size_mb = std::max((int)bench_arg(argc, argv, "size_mb", 512), 1);
+    int rounds = std::max((int)bench_arg(argc, argv, "rounds", 3), 1);
+
+    char path[] = "/tmp/geoserver_bench_upload_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || ftruncate(fd, (off_t)size_mb * 1024 * 1024) != 0) exit(EXIT_FAILURE);
+    close(fd);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    if (!geoserver_api::init("127.0.0.1", server.port(), "admin", "geoserver", 5, 1))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "# PUT of %d MB file to mock, %d rounds, heap RSS before: %ld MB\n",
+        size_mb, rounds, rss_anon_mb());
+    fprintf(stdout, "%-10s %8s %10s %10s %10s %14s\n", "function", "http", "seconds",
+        "MB_per_s", "progress", "max_heap_mb");
+    for (int round = 0; round < rounds; round++)
+    {
+        struct upload_progress progress;
+        geoserver_api::upload_stats stats;
+        bool geotiff = round % 2 == 0;
+        bool ok = (geotiff) ?
+            geoserver_api::upload_geotiff(path, "bench_coverage", "workspace0",
+                track_upload, &progress, &stats) :
+            geoserver_api::upload_shapefile(path, "bench_datastore", "workspace0",
+                track_upload, &progress, &stats);
+        fprintf(stdout, "%-10s %8ld %10.3f %10.1f %10d %14ld\n",
+            (geotiff) ? "geotiff" : "shapefile", (ok) ? geoserver_api::get_http_response_code() : 0,
+            stats.seconds, stats.bytes_per_s / (1024 * 1024), progress.calls,
+            progress.max_rss_anon_mb);
+    }
+
+    geoserver_api::cleanup();
+    server.stop();
+    unlink(path);
+}
+
+// Manifest of "layers" layers with styles and layer groups of 25 layers
+static geoserver_api::batch::manifest reconcile_manifest(const char* workspace, int layers)
+{
+    using namespace geoserver_api;
+    batch::manifest items;
+    for (int i = 0; i < layers; i++)
+    {
+        batch::layer_spec layer;
+        layer.layer_name = "layer_" + std::to_string(i);
+        layer.layer_title = "Layer " + std::to_string(i);
+        layer.postgis_table_name = "table_" + std::to_string(i);
+        layer.workspace = workspace;
+        items.layers.push_back(layer);
+
+        batch::style_spec style;
+        style.layer_name = layer.layer_name;
+        style.style_name = "style_" + std::to_string(i % 7);
+        style.layer_workspace = workspace;
+        style.style_workspace = workspace;
+        items.styles.push_back(style);
+
+        if (i % 25 == 0) items.groups.push_back(batch::group_spec());
+        batch::group_spec& group = items.groups.back();
+        group.layer_group_name = "group_" + std::to_string(i / 25);
+        group.layer_title = "Group " + std::to_string(i / 25);
+        group.layer_names.push_back(layer.layer_name);
+        group.workspace = workspace;
+    }
+    return items;
+}
+
+// Blind re-provisioning vs reconcile of the same manifest
+static void bench_reconcile(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    options.latency_ms = (int)bench_arg(argc, argv, "latency_ms", 2);
+    int layers = std::max((int)bench_arg(argc, argv, "items", 500), 1);
+    int drift = std::min(std::max((int)bench_arg(argc, argv, "drift", 10), 0), layers);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    init_options init_options;
+    init_options.port = server.port();
+    init_options.hostname = "127.0.0.1";
+    if (!init(init_options) || !async::start(32)) exit(EXIT_FAILURE);
+
+    batch::manifest naive = reconcile_manifest("naive", layers);
+    batch::manifest deploy = reconcile_manifest("deploy", layers);
+    fprintf(stdout, "# manifest: %d layers, %d styles, %zu groups, catalog of %d layers, "
+        "latency_ms=%d\n", layers, layers, deploy.groups.size(), options.num_layers,
+        options.latency_ms);
+    fprintf(stdout, "%-38s %8s %8s %8s %10s %10s\n", "run", "writes", "failed",
+        "requests", "unchanged", "ms");
+
+    auto print_row = [&](const char* name, size_t writes, size_t failed, size_t unchanged,
+        const geoserver_mock::mock_stats& before, double ms)
+    {
+        fprintf(stdout, "%-38s %8zu %8zu %8lu %10zu %10.1f\n", name, writes, failed,
+            server.stats().requests - before.requests, unchanged, ms);
+    };
+    for (int round = 0; round < 2; round++)
+    {
+        geoserver_mock::mock_stats before = server.stats();
+        batch::result result = batch::provision(naive);
+        size_t sent = 0, failed = 0;
+        for (const batch::item_result& item : result.items)
+        {
+            sent += !item.skipped;
+            failed += !item.success;
+        }
+        print_row((round) ? "batch::provision (again)" : "batch::provision (first)",
+            sent, failed, 0, before, result.total_ms);
+    }
+
+    auto run_reconcile = [&](const char* name, const reconcile::options& opts)
+    {
+        geoserver_mock::mock_stats before = server.stats();
+        reconcile::report report = reconcile::run(deploy, opts);
+        size_t failed = 0;
+        for (const reconcile::action& act : report.actions) failed += !act.success;
+        print_row(name, (opts.dry_run) ? 0 : report.actions.size(),
+            (opts.dry_run) ? 0 : failed, report.unchanged, before, report.total_ms);
+        return report;
+    };
+    reconcile::options plain;
+    reconcile::options verify;
+    verify.verify_existing = true;
+    run_reconcile("reconcile (first deploy)", plain);
+    run_reconcile("reconcile (unchanged)", plain);
+    run_reconcile("reconcile (unchanged, verify_existing)", verify);
+
+    // Group missing in manifest survives without "prune_workspaces"
+    layer_group_builder unlisted;
+    unlisted.add("deploy", "layer_0");
+    create_layer_group("unlisted_group", "Unlisted", unlisted, "deploy", true);
+    run_reconcile("reconcile (unlisted group, no prune)", verify);
+    layer_list groups;
+    bool kept = false;
+    if (get_layer_groups("deploy", &groups))
+    {
+        for (size_t i = 0; i < groups.size(); i++)
+        {
+            kept = kept || strcmp(groups[i], "deploy:unlisted_group") == 0;
+        }
+    }
+    free_layer_list(&groups);
+    fprintf(stdout, "# unlisted group kept without prune_workspaces: %s\n",
+        (kept) ? "yes" : "NO");
+
+    // Drift made outside of manifest: other styles, renamed group, removed layers
+    for (int i = 0; i < drift; i++)
+    {
+        add_style(("layer_" + std::to_string(i)).c_str(), "manual_style", "deploy", "deploy");
+    }
+    layer_group_builder renamed;
+    renamed.add("deploy", "layer_0");
+    update_layer_group("group_0", "Renamed", renamed, "deploy", true);
+    reconcile::options prune = verify;
+    prune.prune_workspaces.push_back("deploy");
+    deploy.layers.resize(layers - drift);
+    deploy.styles.resize(layers - drift);
+    for (batch::group_spec& group : deploy.groups)
+    {
+        while (!group.layer_names.empty() &&
+            atoi(group.layer_names.back().c_str() + 6) >= layers - drift)
+        {
+            group.layer_names.pop_back();
+        }
+    }
+    while (!deploy.groups.empty() && deploy.groups.back().layer_names.empty())
+    {
+        deploy.groups.pop_back();
+    }
+    prune.dry_run = true;
+    reconcile::report planned = run_reconcile("reconcile (drift, dry run)", prune);
+    prune.dry_run = false;
+    run_reconcile("reconcile (drift, verify + prune)", prune);
+    run_reconcile("reconcile (unchanged after repair)", prune);
+    fprintf(stdout, "\n# dry run report of drift:\n");
+    reconcile::print_report(planned);
+
+    async::stop();
+    cleanup();
+    server.stop();
+}
+
+// Service restarts: cold start downloads catalog, warm start maps snapshot
+static void bench_snapshot(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    options.num_layers = (int)bench_arg(argc, argv, "layers", 100000);
+    options.bandwidth_mbit = (int)bench_arg(argc, argv, "bandwidth_mbit", 100);
+    int starts = std::max((int)bench_arg(argc, argv, "starts", 5), 2);
+
+    char path[] = "/tmp/geoserver_bench_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) exit(EXIT_FAILURE);
+    close(fd);
+    unlink(path); // first start has no snapshot
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    fprintf(stdout, "# layers=%d bandwidth_mbit=%d, process start emulated by fresh cache\n",
+        options.num_layers, options.bandwidth_mbit);
+    fprintf(stdout, "%-26s %8s %14s %12s %14s %12s\n", "start", "loaded", "first_read_ms",
+        "layers", "revalidation", "wire_kb");
+
+    for (int start = 0; start < starts; start++)
+    {
+        // Catalog changes before last start, snapshot must be replaced
+        bool changed = start == starts - 1;
+        if (!init("127.0.0.1", server.port(), "admin", "geoserver", 10, 2)) exit(EXIT_FAILURE);
+        if (changed) create_layer("bench_new_layer", "new", "table", NULL, "workspace0");
+
+        geoserver_mock::mock_stats before = server.stats();
+        bench_clock::time_point begin = bench_clock::now();
+        enable_catalog_cache(60);
+        bool loaded = enable_catalog_snapshot(path);
+        bool exists = false;
+        bool ok = layer_exists("workspace0:layer_4", &exists) && exists;
+        double first_read_ms = elapsed_ms(begin);
+        long revalidation = wait_catalog_revalidation();
+
+        struct layer_list layers;
+        ok = get_layers(NULL, &layers) && ok;
+        size_t num_layers = layers.size();
+        free_layer_list(&layers);
+        const char* name = (start == 0) ? "cold (no snapshot)" :
+            (changed) ? "warm (catalog changed)" : "warm";
+        fprintf(stdout, "%-26s %8s %14.2f %12zu %14ld %12.1f%s\n", name,
+            (loaded) ? "yes" : "no", first_read_ms, num_layers, revalidation,
+            (server.stats().bytes_sent - before.bytes_sent) / 1024.0,
+            (ok) ? "" : "  failed");
+
+        disable_catalog_cache();
+        cleanup();
+    }
+    server.stop();
+    unlink(path);
+}
+
+// Same writes to several nodes: one node after another vs fan-out
+static void bench_cluster(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 50), 1);
+    const int latencies_ms[] = {2, 5, 10, 25}; // uneven nodes
+    const int num_nodes = sizeof(latencies_ms) / sizeof(latencies_ms[0]);
+
+    std::vector<geoserver_mock::mock_server> servers(num_nodes);
+    std::vector<cluster::node> nodes;
+    for (int i = 0; i < num_nodes; i++)
+    {
+        geoserver_mock::mock_options options = mock_args(argc, argv);
+        options.latency_ms = latencies_ms[i];
+        if (!servers[i].start(options)) exit(EXIT_FAILURE);
+        cluster::node address;
+        address.hostname = "127.0.0.1";
+        address.port = servers[i].port();
+        nodes.push_back(address);
+    }
+    fprintf(stdout, "# create_layer on %d nodes with latency 2/5/10/25 ms, ops=%d\n",
+        num_nodes, ops);
+    fprintf(stdout, "%-22s %8s %8s %10s %10s %12s\n", "mode", "ops", "failed", "p50_ms",
+        "p99_ms", "ops_per_s");
+
+    // Single global url: init() and cleanup() for every node
+    op_report sequential;
+    bench_clock::time_point start = bench_clock::now();
+    for (int i = 0; i < ops; i++)
+    {
+        bench_clock::time_point op_start = bench_clock::now();
+        std::string name = "sequential_" + std::to_string(i);
+        bool ok = true;
+        for (const cluster::node& address : nodes)
+        {
+            ok = init(address.hostname.c_str(), address.port, "admin", "geoserver", 5, 1) &&
+                create_layer(name.c_str(), "title", "table", NULL, "workspace0") &&
+                get_http_response_code() == 201 && ok;
+            cleanup();
+        }
+        sequential.latencies_ms.push_back(elapsed_ms(op_start));
+        if (!ok) sequential.failed++;
+    }
+    sequential.print("sequential", elapsed_ms(start));
+
+    if (!init("127.0.0.1", servers[0].port(), "admin", "geoserver", 5, 1) ||
+        !async::start(64))
+    {
+        exit(EXIT_FAILURE);
+    }
+    for (int quorum = 0; quorum < 2; quorum++)
+    {
+        cluster::client cluster(nodes, (quorum) ? cluster::WRITE_QUORUM : cluster::WRITE_ALL);
+        op_report report;
+        start = bench_clock::now();
+        for (int i = 0; i < ops; i++)
+        {
+            std::string name = "cluster_" + std::to_string(quorum) + "_" + std::to_string(i);
+            bench_clock::time_point op_start = bench_clock::now();
+            cluster::write_result result = cluster.create_layer(name.c_str(), "title",
+                "table", NULL, "workspace0");
+            report.latencies_ms.push_back(elapsed_ms(op_start));
+            if (!result.success) report.failed++;
+        }
+        report.print((quorum) ? "cluster WRITE_QUORUM" : "cluster WRITE_ALL",
+            elapsed_ms(start));
+    }
+
+    // Node without server: WRITE_ALL fails, WRITE_QUORUM succeeds
+    nodes.back().port = 1;
+    for (int quorum = 0; quorum < 2; quorum++)
+    {
+        cluster::client cluster(nodes, (quorum) ? cluster::WRITE_QUORUM : cluster::WRITE_ALL);
+        fprintf(stdout, "\n# %s with one node down:\n",
+            (quorum) ? "WRITE_QUORUM" : "WRITE_ALL");
+        std::string name = "down_" + std::to_string(quorum);
+        cluster::print_result(cluster.create_layer(name.c_str(), "title", "table", NULL,
+            "workspace0"));
+    }
+    async::stop();
+
+    // Concurrent writes without started engine share engine of first write
+    nodes.back().port = servers.back().port();
+    {
+        const int threads = 8;
+        cluster::client cluster(nodes, cluster::WRITE_QUORUM);
+        std::vector<op_report> reports(threads);
+        std::vector<std::thread> workers;
+        start = bench_clock::now();
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t]
+            {
+                for (int i = t; i < ops; i += threads)
+                {
+                    std::string name = "shared_engine_" + std::to_string(i);
+                    bench_clock::time_point op_start = bench_clock::now();
+                    cluster::write_result result = cluster.create_layer(name.c_str(),
+                        "title", "table", NULL, "workspace0");
+                    reports[t].latencies_ms.push_back(elapsed_ms(op_start));
+                    if (!result.success) reports[t].failed++;
+                }
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+        op_report total;
+        for (op_report& report : reports)
+        {
+            total.latencies_ms.insert(total.latencies_ms.end(),
+                report.latencies_ms.begin(), report.latencies_ms.end());
+            total.failed += report.failed;
+        }
+        fprintf(stdout, "\n");
+        total.print("8 threads, no engine", elapsed_ms(start));
+    }
+
+    cleanup();
+    for (geoserver_mock::mock_server& server : servers) server.stop();
+}
+
+// Reads from uneven replicas: round-robin vs power-of-two-choices
+static void bench_replicas(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    int threads = std::max((int)bench_arg(argc, argv, "threads", 4), 1);
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 2000), 1);
+
+    // Two healthy nodes, one slowing down under load, one slow, one failing
+    const int num_nodes = 5;
+    std::vector<geoserver_mock::mock_server> servers(num_nodes);
+    std::vector<cluster::node> nodes;
+    for (int i = 0; i < num_nodes; i++)
+    {
+        geoserver_mock::mock_options options = mock_args(argc, argv);
+        options.num_layers = (int)bench_arg(argc, argv, "layers", 100);
+        options.latency_ms = (i == 3) ? 20 : 2;
+        if (i == 2) options.load_latency_ms = 5;
+        if (i == 4) options.error_rate = 0.5;
+        if (!servers[i].start(options)) exit(EXIT_FAILURE);
+        cluster::node address;
+        address.hostname = "127.0.0.1";
+        address.port = servers[i].port();
+        nodes.push_back(address);
+    }
+    if (!init("127.0.0.1", servers[0].port(), "admin", "geoserver", 5, threads))
+    {
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "# get_layers on %d replicas: 2 ms, 2 ms, 2 ms + 5 ms per request "
+        "in progress, 20 ms, 2 ms with 50%% errors; threads=%d ops=%d\n", num_nodes,
+        threads, ops);
+
+    // Plain round-robin, round-robin with ejection, power-of-two-choices with ejection
+    const char* const mode_names[] = {"round-robin", "round-robin eject", "power-of-two"};
+    for (int mode = 0; mode < 3; mode++)
+    {
+        cluster::client cluster(nodes);
+        cluster::read_options read_options;
+        read_options.selection = (mode == 2) ? cluster::SELECT_POWER_OF_TWO :
+            cluster::SELECT_ROUND_ROBIN;
+        if (mode == 0)
+        {
+            read_options.eject_after_failures = 0;
+            read_options.eject_latency_factor = 0;
+        }
+        cluster.set_read_options(read_options);
+
+        std::vector<op_report> reports(threads);
+        bench_clock::time_point start = bench_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&, t]
+            {
+                layer_list layers;
+                for (int i = t; i < ops; i += threads)
+                {
+                    bench_clock::time_point op_start = bench_clock::now();
+                    bool ok = cluster.get_layers(NULL, &layers);
+                    reports[t].latencies_ms.push_back(elapsed_ms(op_start));
+                    if (!ok) reports[t].failed++;
+                }
+                free_layer_list(&layers);
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+        double wall_ms = elapsed_ms(start);
+
+        op_report total;
+        for (const op_report& report : reports)
+        {
+            total.latencies_ms.insert(total.latencies_ms.end(), report.latencies_ms.begin(),
+                report.latencies_ms.end());
+            total.failed += report.failed;
+        }
+        fprintf(stdout, "\n%-22s %8s %8s %10s %10s %12s\n", "mode", "ops", "failed",
+            "p50_ms", "p99_ms", "ops_per_s");
+        total.print(mode_names[mode], wall_ms);
+        cluster::print_replica_stats(cluster.get_replica_stats());
+    }
+
+    cleanup();
+    for (geoserver_mock::mock_server& server : servers) server.stop();
+}
+
+// Interactive add_style calls during bulk create_layer: single FIFO class
+// vs weighted fair queuing vs weighted fair queuing with bulk in-flight limit
+static void bench_priority(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    if (!options.latency_ms) options.latency_ms = 5;
+    int bulk_ops = std::max((int)bench_arg(argc, argv, "ops", 3000), 1);
+    int concurrency = std::max((int)bench_arg(argc, argv, "concurrency", 16), 2);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    if (!init("127.0.0.1", server.port(), "admin", "geoserver", 5, 1)) exit(EXIT_FAILURE);
+    fprintf(stdout, "# %d bulk create_layer, interactive add_style every 10 ms until bulk "
+        "is done, latency_ms=%d concurrency=%d\n", bulk_ops, options.latency_ms, concurrency);
+    fprintf(stdout, "%-18s %10s %8s %12s %12s %12s %12s\n", "mode", "bulk_ops_s",
+        "calls", "inter_p50_ms", "inter_max_ms", "queue_p50_ms", "net_p50_ms");
+
+    const char* const mode_names[] = {"fifo", "wfq", "wfq bulk_limit"};
+    for (int mode = 0; mode < 3; mode++)
+    {
+        async::priority_options bulk_options;
+        if (mode == 2) bulk_options.max_in_flight = concurrency * 3 / 4;
+        async::set_priority_options(async::PRIORITY_BULK, bulk_options);
+        if (!async::start(concurrency)) exit(EXIT_FAILURE);
+        // FIFO: interactive calls queue in the same class as bulk ones
+        async::priority interactive = (mode) ? async::PRIORITY_INTERACTIVE : async::PRIORITY_BULK;
+
+        bench_clock::time_point start = bench_clock::now();
+        std::atomic<int> bulk_done{0};
+        std::atomic<double> bulk_wall_ms{0};
+        std::vector<std::future<async::response>> bulk;
+        {
+            async::priority_scope scope(async::PRIORITY_BULK);
+            for (int i = 0; i < bulk_ops; i++)
+            {
+                std::string name = "bulk_" + std::to_string(mode) + "_" + std::to_string(i);
+                bulk.push_back(async::create_layer(name.c_str(), "title", "table", NULL,
+                    "workspace0", "postgis", true, [&](const async::response&)
+                    {
+                        if (++bulk_done == bulk_ops) bulk_wall_ms = elapsed_ms(start);
+                    }));
+            }
+        }
+
+        // Operator calls while bulk is running, one after another
+        std::vector<double> latencies_ms, queue_ms, network_ms;
+        {
+            async::priority_scope scope(interactive);
+            do
+            {
+                bench_clock::time_point op_start = bench_clock::now();
+                async::response resp = async::add_style("layer0", "style0", "workspace0",
+                    "workspace0").get();
+                latencies_ms.push_back(elapsed_ms(op_start));
+                queue_ms.push_back(resp.timing.queue_s * 1e3);
+                network_ms.push_back(resp.timing.total_s * 1e3);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            } while (bulk_done < bulk_ops);
+        }
+        for (std::future<async::response>& future : bulk) future.wait();
+        async::stop();
+
+        for (std::vector<double>* values : {&latencies_ms, &queue_ms, &network_ms})
+        {
+            std::sort(values->begin(), values->end());
+        }
+        size_t n = latencies_ms.size();
+        fprintf(stdout, "%-18s %10.0f %8zu %12.3f %12.3f %12.3f %12.3f\n", mode_names[mode],
+            bulk_ops * 1000.0 / bulk_wall_ms, n, latencies_ms[n / 2], latencies_ms[n - 1],
+            queue_ms[n / 2], network_ms[n / 2]);
+    }
+
+    async::set_priority_options(async::PRIORITY_BULK, async::priority_options());
+    cleanup();
+    server.stop();
+}
+
+// Bulk create_layer against server with concurrency ceiling: fixed
+// concurrency vs adaptive concurrency limit, blocking and async
+static void bench_limiter(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    if (!options.latency_ms) options.latency_ms = 5;
+    if (!options.load_latency_ms) options.load_latency_ms = 1;
+    if (!options.max_concurrent) options.max_concurrent = 12;
+    int ops = std::max((int)bench_arg(argc, argv, "ops", 3000), 1);
+    int concurrency = std::max((int)bench_arg(argc, argv, "concurrency", 48), 1);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    if (!init("127.0.0.1", server.port(), "admin", "geoserver", 5, concurrency))
+    {
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "# create_layer, server: latency %d ms + %d ms per request in progress, "
+        "503 above %d requests; client concurrency=%d ops=%d\n", options.latency_ms,
+        options.load_latency_ms, options.max_concurrent, concurrency, ops);
+    fprintf(stdout, "%-22s %8s %8s %10s %10s %12s %10s %6s %10s\n", "mode", "ops", "failed",
+        "p50_ms", "p99_ms", "ops_per_s", "ok_per_s", "limit", "decreases");
+
+    for (int mode = 0; mode < 4; mode++)
+    {
+        bool adaptive = mode % 2;
+        bool blocking = mode < 2;
+        struct concurrency_limit limit;
+        limit.enabled = adaptive;
+        set_concurrency_limit(limit);
+
+        std::string prefix = "limiter_" + std::to_string(mode) + "_";
+        std::string name = std::string((blocking) ? "blocking" : "async") +
+            ((adaptive) ? " adaptive" : " fixed");
+        std::atomic<int> succeeded{0};
+        bench_clock::time_point start = bench_clock::now();
+        if (blocking)
+        {
+            run_sync_op(name.c_str(), concurrency, ops, [&](int, int i)
+            {
+                std::string layer = prefix + std::to_string(i);
+                bool ok = create_layer(layer.c_str(), "title", "table", NULL, "workspace0");
+                if (ok && get_http_response_code() == 201) succeeded++;
+                return ok;
+            }, false);
+        }
+        else
+        {
+            // Latency from submit, queue wait included
+            if (!async::start(concurrency)) exit(EXIT_FAILURE);
+            std::vector<std::future<async::response>> futures;
+            for (int i = 0; i < ops; i++)
+            {
+                std::string layer = prefix + std::to_string(i);
+                futures.push_back(async::create_layer(layer.c_str(), "title", "table", NULL,
+                    "workspace0"));
+            }
+            op_report report;
+            for (std::future<async::response>& future : futures)
+            {
+                async::response resp = future.get();
+                report.latencies_ms.push_back((resp.timing.queue_s + resp.timing.total_s) * 1e3);
+                if (!resp.success || resp.http_code != 201) report.failed++;
+                else succeeded++;
+            }
+            double wall_ms = elapsed_ms(start);
+            async::stop();
+            report.print(name.c_str(), wall_ms, false);
+        }
+        struct concurrency_limit_stats stats = get_concurrency_limit_stats();
+        fprintf(stdout, " %10.0f %6d %10llu\n", succeeded * 1000.0 / elapsed_ms(start),
+            stats.limit, (unsigned long long)stats.decreases);
+    }
+
+    set_concurrency_limit(concurrency_limit());
+    cleanup();
+    server.stop();
+}
+
+// Startup storm: many threads ask for the same layer list at once
+static void bench_singleflight(int argc, char** argv)
+{
+    using namespace geoserver_api;
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    options.num_layers = (int)bench_arg(argc, argv, "layers", 20000);
+    if (!options.latency_ms) options.latency_ms = 20;
+    int threads = std::max((int)bench_arg(argc, argv, "threads", 32), 1);
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    if (!init("127.0.0.1", server.port(), "admin", "geoserver", 5, threads)) exit(EXIT_FAILURE);
+    fprintf(stdout, "# %d threads call get_layers at once, layers=%d latency_ms=%d\n",
+        threads, options.num_layers, options.latency_ms);
+    fprintf(stdout, "%-22s %8s %8s %10s %10s %12s %10s\n", "mode", "ops", "failed",
+        "p50_ms", "p99_ms", "ops_per_s", "requests");
+
+    // Streaming calls are not coalesced, as every caller has own callback
+    const char* const mode_names[] = {"stream, not shared", "get_layers",
+        "get_layers workspace", "get_layers cold cache"};
+    for (int mode = 0; mode < 4; mode++)
+    {
+        if (mode == 3) enable_catalog_cache(60);
+        unsigned long requests_before = server.stats().requests;
+        std::atomic<int> ready{0};
+        run_sync_op(mode_names[mode], threads, threads, [&](int, int)
+        {
+            // Start all threads together
+            ready++;
+            while (ready < threads) std::this_thread::yield();
+
+            layer_list layers;
+            const char* workspace = (mode == 2) ? "workspace0" : NULL;
+            bool ok = (mode == 0) ?
+                get_layers_stream(workspace, [](const char* name, void* user_data)
+                {
+                    return ((layer_list*)user_data)->push_back(name);
+                }, &layers) :
+                get_layers(workspace, &layers);
+            ok = ok && layers.size() > 0;
+            free_layer_list(&layers);
+            return ok;
+        }, false);
+        fprintf(stdout, " %10lu\n", server.stats().requests - requests_before);
+    }
+
+    disable_catalog_cache();
+    cleanup();
+    server.stop();
+}
+
+static void run_mock(int argc, char** argv)
+{
+    geoserver_mock::mock_options options = mock_args(argc, argv);
+    if (!options.port) options.port = 8080;
+
+    geoserver_mock::mock_server server;
+    if (!server.start(options)) exit(EXIT_FAILURE);
+    fprintf(stdout, "mock Geoserver listening on 127.0.0.1:%d\n", server.port());
+    fflush(stdout);
+    while (true) pause();
+}
+
+int main(int argc, char** argv)
+{
+    const char* section = (argc > 1) ? argv[1] : NULL;
+
+    if (section && strcmp(section, "mock") == 0) run_mock(argc, argv);
+    if (!section || strcmp(section, "catalog") == 0) bench_catalog();
+    if (!section || strcmp(section, "payload") == 0) bench_payload();
+    if (!section || strcmp(section, "metrics") == 0) bench_metrics();
+    if (!section || strcmp(section, "e2e") == 0) bench_e2e(argc, argv);
+    if (!section || strcmp(section, "share") == 0) bench_share(argc, argv);
+    if (!section || strcmp(section, "retry") == 0) bench_retry(argc, argv);
+    if (section && strcmp(section, "h2") == 0) bench_h2(argc, argv);
+    if (section && strcmp(section, "tls") == 0) bench_tls(argc, argv);
+    if (section && strcmp(section, "upload") == 0) bench_upload(argc, argv);
+    if (section && strcmp(section, "compression") == 0) bench_compression(argc, argv);
+    if (section && strcmp(section, "reconcile") == 0) bench_reconcile(argc, argv);
+    if (section && strcmp(section, "snapshot") == 0) bench_snapshot(argc, argv);
+    if (section && strcmp(section, "cluster") == 0) bench_cluster(argc, argv);
+    if (section && strcmp(section, "replicas") == 0) bench_replicas(argc, argv);
+    if (section && strcmp(section, "priority") == 0) bench_priority(argc, argv);
+    if (section && strcmp(section, "limiter") == 0) bench_limiter(argc, argv);
+    if (section && strcmp(section, "singleflight") == 0) bench_singleflight(argc, argv);
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 
-g++ --std=c++17 -o main exmaple.cpp geoserver_curl_wrapper.cpp  -lcurl \
-    `pkg-config --cflags --libs libxml-2.0`
-
+g++ --std=c++17 -pthread -o main exmaple.cpp geoserver_curl_wrapper.cpp geoserver_async.cpp \
+    geoserver_batch.cpp geoserver_catalog_cache.cpp geoserver_cluster.cpp geoserver_json.cpp \
+    geoserver_limiter.cpp geoserver_metrics.cpp geoserver_reconcile.cpp geoserver_retry.cpp \
+    -lcurl -lz `pkg-config --cflags --libs libxml-2.0`
@@ -0,0 +1,6 @@
+
+g++ --std=c++17 -O2 -pthread -o benchmark benchmark.cpp geoserver_curl_wrapper.cpp \
+    geoserver_async.cpp geoserver_batch.cpp geoserver_catalog_cache.cpp geoserver_cluster.cpp \
+    geoserver_json.cpp geoserver_limiter.cpp geoserver_metrics.cpp geoserver_reconcile.cpp \
+    geoserver_retry.cpp mock_geoserver.cpp \
+    -lcurl -lz `pkg-config --cflags --libs libxml-2.0`
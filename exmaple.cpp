@@ -6,18 +6,19 @@
 #include "geoserver_curl_wrapper.hpp"
 #include "geoserver_custom_structs.hpp"
 
+// Usage: ./main [hostname] [port] [username] [password]
 int main(int argc, char** argv)
 {
-    const char* hostname = "localhost";
-    const int port = 8080;
-    const char* username = "admin";
-    const char* password = "geoserver";
+    const char* hostname = (argc > 1) ? argv[1] : "localhost";
+    const int port = (argc > 2) ? atoi(argv[2]) : 8080;
+    const char* username = (argc > 3) ? argv[3] : "admin";
+    const char* password = (argc > 4) ? argv[4] : "geoserver";
     const int timeout_s = 3;
 
     bool status;
 
     // initlize "geoserver_curl_wrapper"
-    status = geoserver_api::init("localhost", 8080, "admin", "geoserver", 3);
+    status = geoserver_api::init(hostname, port, username, password, timeout_s);
     if (!status) exit(EXIT_FAILURE);  // If failes, exit
 
     // 1. Create layer
@@ -111,26 +112,20 @@ int main(int argc, char** argv)
         const char* layer_name = "layer_group3";
         const char* layer_title = "layer_group3";
         bool advertised = true;
-        const char* layers[] = {"example_layer1", "example_layer2"};
         const char* layer_workspace = "forestAI";
 
-        char* structure = geoserver_api::prepare_layer_group(layer_workspace,
-            sizeof(layers) / sizeof(layers[0]), layers[0], layers[1]);
-        if (!structure)
-        {
-            fprintf(stdout, "prepare_layer_group() failed");
-            goto end;
-        }
+        // Each layer can have own style, NULL - default style
+        geoserver_api::layer_group_builder layers;
+        layers.add(layer_workspace, "example_layer1", "density", layer_workspace);
+        layers.add(layer_workspace, "example_layer2");
 
-        status = geoserver_api::create_layer_group(layer_name, layer_title, structure,
+        status = geoserver_api::create_layer_group(layer_name, layer_title, layers,
            layer_workspace, advertised);
         http_response_body = geoserver_api::get_http_response_body();
         http_response_code = geoserver_api::get_http_response_code();
     
         fprintf(stdout, "Creating layer group - status: %d.\nresponse body: %s\n"
             "response code: %ld\n", status, http_response_body, http_response_code);
-
-        if (structure) free(structure);
     }
 
     // 6. Get all layer names
@@ -0,0 +1,735 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+#include "geoserver_async.hpp"
+#include "geoserver_internal.hpp"
+
+namespace geoserver_api
+{
+namespace async
+{
+    // Single request owned by event-loop
+    struct async_job
+    {
+        struct http_request request;
+        metrics::operation operation = metrics::OP_COUNT;
+        bool parse_layers = false;
+        catalog_format format = FORMAT_XML;
+        bool filter_workspace = false;
+        std::string workspace;
+        completion_callback callback;
+        std::promise<response> promise;
+        int attempt = 1;
+        priority prio = PRIORITY_INTERACTIVE;
+        struct limiter_slot slot; // of "concurrency_limit"
+        std::chrono::steady_clock::time_point queued_at;
+        double queue_s = 0; // all waits in queue, retries included
+
+        CURL* curl = NULL;
+        struct curl_slist* header = NULL;
+        struct data_clb_pointer<char> body;
+    };
+
+    // Queue of single priority class, protected by "queue_mutex"
+    struct priority_class
+    {
+        std::deque<struct async_job*> queue;
+        priority_options options;
+        int in_flight = 0;
+        // Virtual time of weighted fair queuing: every started request
+        // adds 1 / weight, class with lowest virtual time goes first
+        double virtual_time = 0;
+        priority_stats stats;
+
+        explicit priority_class(int weight) { options.weight = weight; }
+    };
+
+    // global variables
+    static CURLM* multi = NULL; // written under both mutexes, read under either
+    static std::thread loop_thread;
+    static std::mutex engine_mutex; // serializes start, stop, acquire and release
+    static std::mutex queue_mutex;
+    static int engine_users = 0; // of "acquire()", protected by "engine_mutex"
+    static bool engine_acquired = false; // started by "acquire()"
+    static struct priority_class classes[PRIORITY_COUNT] = {priority_class(4), priority_class(1)};
+    static double scheduler_time = 0; // virtual time of last started request
+    static bool stopping = false; // protected by "queue_mutex"
+    static thread_local priority thread_priority = PRIORITY_INTERACTIVE;
+    static std::atomic<int> max_in_flight_requests{32};
+    static std::vector<CURL*> free_handles; // used only by event-loop thread
+    // Jobs waiting for retry by due time, used only by event-loop thread
+    static std::multimap<std::chrono::steady_clock::time_point, struct async_job*> delayed_jobs;
+
+    static bool store_layer_name(const char* name, void* user_data)
+    {
+        ((std::vector<std::string>*)user_data)->emplace_back(name);
+        return true;
+    }
+
+    static void finish_job(struct async_job* job, CURLcode res)
+    {
+        response resp;
+        resp.curl_code = res;
+        resp.success = (res == CURLE_OK);
+        if (job->curl)
+        {
+            curl_easy_getinfo(job->curl, CURLINFO_RESPONSE_CODE, &resp.http_code);
+            record_request(job->operation, job->curl, res, resp.http_code, &resp.timing);
+        }
+        if (job->body.p) resp.body.assign(job->body.p, job->body.length);
+        resp.timing.queue_s = job->queue_s;
+        if (job->curl) record_queue_wait(job->operation, job->queue_s);
+
+        if (resp.success && job->parse_layers &&
+            resp.http_code >= 200 && resp.http_code < 300)
+        {
+            const char* workspace = (job->filter_workspace) ? job->workspace.c_str() : NULL;
+            if (job->format == FORMAT_JSON)
+            {
+                resp.success = parse_layers_json(resp.body.c_str(), resp.body.size(),
+                    workspace, store_layer_name, &resp.layer_names);
+            }
+            else
+            {
+                resp.success = parse_layers_xml(resp.body.c_str(), resp.body.size(),
+                    workspace, store_layer_name, &resp.layer_names);
+            }
+        }
+        if (is_catalog_write(job->request, res, resp.http_code)) invalidate_catalog_cache();
+        if (res != CURLE_OK)
+        {
+            fprintf(stderr, "async request %s failed with code: %d\n",
+                job->request.url.c_str(), res);
+        }
+
+        if (job->callback)
+        {
+            // Follow-up requests of callback stay in class of this one
+            priority_scope scope(job->prio);
+            job->callback(resp);
+        }
+        job->promise.set_value(std::move(resp));
+
+        if (job->header) curl_slist_free_all(job->header);
+        if (job->body.p) free(job->body.p);
+        if (job->curl) free_handles.push_back(job->curl);
+        delete job;
+    }
+
+    // Put failed job aside for retry, returns false if retry policy gives up
+    static bool schedule_retry(struct async_job* job, CURLcode res)
+    {
+        const struct retry_policy policy = get_retry_policy();
+        long http_code = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_RESPONSE_CODE, &http_code);
+        if (job->attempt >= policy.max_attempts ||
+            !is_retryable(job->request, res, http_code)) return false;
+
+        record_request(job->operation, job->curl, res, http_code, NULL);
+        record_retry(job->operation);
+        curl_off_t retry_after_s = 0;
+        curl_easy_getinfo(job->curl, CURLINFO_RETRY_AFTER, &retry_after_s);
+        long delay_ms = retry_delay_ms(policy, job->attempt, retry_after_s);
+        job->attempt++;
+
+        // Handle is not needed while waiting
+        if (job->header) curl_slist_free_all(job->header);
+        job->header = NULL;
+        free_handles.push_back(job->curl);
+        job->curl = NULL;
+        if (job->body.p) job->body.reset();
+
+        delayed_jobs.emplace(std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(delay_ms), job);
+        return true;
+    }
+
+    // Caller must hold "queue_mutex"
+    static void enqueue(struct async_job* job, bool front)
+    {
+        struct priority_class& cls = classes[job->prio];
+        // Idle class starts at current virtual time, it has no credit for idle time
+        if (cls.queue.empty()) cls.virtual_time = std::max(cls.virtual_time, scheduler_time);
+        job->queued_at = std::chrono::steady_clock::now();
+        if (front) cls.queue.push_front(job);
+        else cls.queue.push_back(job);
+    }
+
+    // Next job by weighted fair queuing, NULL if no class may start one.
+    // Caller must hold "queue_mutex".
+    static struct async_job* dequeue()
+    {
+        int best = -1;
+        for (int p = 0; p < PRIORITY_COUNT; p++)
+        {
+            const struct priority_class& cls = classes[p];
+            if (cls.queue.empty()) continue;
+            if (cls.options.max_in_flight > 0 && cls.in_flight >= cls.options.max_in_flight) continue;
+            if (best < 0 || cls.virtual_time < classes[best].virtual_time) best = p;
+        }
+        if (best < 0) return NULL;
+
+        struct priority_class& cls = classes[best];
+        struct async_job* job = cls.queue.front();
+        cls.queue.pop_front();
+        scheduler_time = cls.virtual_time;
+        cls.virtual_time += 1.0 / std::max(cls.options.weight, 1);
+
+        double wait_s = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - job->queued_at).count();
+        job->queue_s += wait_s;
+        cls.stats.queue_wait_s += wait_s;
+        cls.stats.max_queue_wait_s = std::max(cls.stats.max_queue_wait_s, wait_s);
+        return job;
+    }
+
+    static bool start_job(struct async_job* job)
+    {
+        if (free_handles.empty())
+        {
+            job->curl = curl_easy_init();
+            if (!job->curl)
+            {
+                fprintf(stderr, "curl_easy_init(): failed\n");
+                return false;
+            }
+        }
+        else
+        {
+            job->curl = free_handles.back();
+            free_handles.pop_back();
+            curl_easy_reset(job->curl); // Keeps live connections
+        }
+
+        apply_handle_options(job->curl, &job->body);
+        curl_easy_setopt(job->curl, CURLOPT_PRIVATE, job);
+        setup_request(job->curl, job->request, &job->header);
+
+        if (curl_multi_add_handle(multi, job->curl) != CURLM_OK)
+        {
+            fprintf(stderr, "curl_multi_add_handle(): failed\n");
+            return false;
+        }
+        return true;
+    }
+
+    static void event_loop()
+    {
+        int in_flight = 0;
+        while (true)
+        {
+            // Move queued jobs on the wire
+            std::deque<struct async_job*> failed;
+            bool limited = false; // concurrency limit left jobs in queue
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                // Due retries go before new jobs
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                while (!delayed_jobs.empty() && delayed_jobs.begin()->first <= now)
+                {
+                    enqueue(delayed_jobs.begin()->second, true);
+                    delayed_jobs.erase(delayed_jobs.begin());
+                }
+                struct async_job* job;
+                struct limiter_slot slot;
+                while (in_flight < max_in_flight_requests)
+                {
+                    if (!try_acquire_limiter_slot(&slot))
+                    {
+                        limited = true;
+                        break;
+                    }
+                    if (!(job = dequeue()))
+                    {
+                        release_limiter_slot(&slot, CURLE_FAILED_INIT, 0, 0);
+                        break;
+                    }
+                    job->slot = slot;
+                    if (start_job(job))
+                    {
+                        in_flight++;
+                        classes[job->prio].in_flight++;
+                        classes[job->prio].stats.started++;
+                    }
+                    else
+                    {
+                        release_limiter_slot(&job->slot, CURLE_FAILED_INIT, 0, 0);
+                        failed.push_back(job);
+                    }
+                }
+                bool queued = false;
+                for (const struct priority_class& cls : classes) queued |= !cls.queue.empty();
+                limited = limited && queued;
+                if (stopping && !queued && in_flight == 0 && failed.empty() &&
+                    delayed_jobs.empty()) break;
+            }
+            for (struct async_job* job : failed) finish_job(job, CURLE_FAILED_INIT);
+
+            int still_running = 0;
+            curl_multi_perform(multi, &still_running);
+
+            bool completed = false;
+            int msgs_left = 0;
+            CURLMsg* msg;
+            while ((msg = curl_multi_info_read(multi, &msgs_left)))
+            {
+                if (msg->msg != CURLMSG_DONE) continue;
+
+                struct async_job* job = NULL;
+                CURL* easy = msg->easy_handle;
+                CURLcode res = msg->data.result;
+                curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char**)&job);
+                curl_multi_remove_handle(multi, easy);
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    classes[job->prio].in_flight--;
+                }
+                long http_code = 0;
+                curl_off_t total_us = 0;
+                curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &http_code);
+                curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total_us);
+                release_limiter_slot(&job->slot, res, http_code, total_us / 1e6);
+                if (!schedule_retry(job, res)) finish_job(job, res);
+                in_flight--;
+                completed = true;
+            }
+
+            // Slots were freed, start queued jobs without waiting
+            if (completed) continue;
+            int timeout_ms = 1000;
+            if (!delayed_jobs.empty())
+            {
+                long long until_due_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    delayed_jobs.begin()->first - std::chrono::steady_clock::now()).count();
+                timeout_ms = (int)std::max(0ll, std::min(until_due_ms + 1, 1000ll));
+            }
+            // Blocking calls free limiter slots without waking event-loop
+            if (limited) timeout_ms = std::min(timeout_ms, 5);
+            curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+        }
+    }
+
+    // Caller must hold "engine_mutex"
+    static bool start_engine(const int max_in_flight)
+    {
+        if (max_in_flight < 1)
+        {
+            fprintf(stderr, "async::start(): max_in_flight must be positive\n");
+            return false;
+        }
+        if (get_base_url()[0] == 0)
+        {
+            fprintf(stderr, "async::start(): call geoserver_api::init() first\n");
+            return false;
+        }
+        if (multi)
+        {
+            fprintf(stderr, "async::start(): already started\n");
+            return false;
+        }
+
+        CURLM* handle = curl_multi_init();
+        if (!handle)
+        {
+            fprintf(stderr, "curl_multi_init(): failed\n");
+            return false;
+        }
+        max_in_flight_requests = max_in_flight;
+        curl_multi_setopt(handle, CURLMOPT_MAXCONNECTS, (long)max_in_flight);
+        curl_multi_setopt(handle, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(handle, CURLMOPT_MAX_HOST_CONNECTIONS, get_max_host_connections());
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            multi = handle;
+            stopping = false;
+            scheduler_time = 0;
+            for (struct priority_class& cls : classes)
+            {
+                cls.in_flight = 0;
+                cls.virtual_time = 0;
+                cls.stats = priority_stats();
+            }
+        }
+        loop_thread = std::thread(event_loop);
+        return true;
+    }
+
+    // Caller must hold "engine_mutex"
+    static void stop_engine()
+    {
+        if (!multi) return;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+            curl_multi_wakeup(multi);
+        }
+        loop_thread.join();
+
+        for (CURL* handle : free_handles) curl_easy_cleanup(handle);
+        free_handles.clear();
+        CURLM* handle = multi;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            multi = NULL;
+        }
+        curl_multi_cleanup(handle);
+    }
+
+    bool start(const int max_in_flight)
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        return start_engine(max_in_flight);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        stop_engine();
+        engine_acquired = false;
+    }
+
+    bool acquire(const int max_in_flight)
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        if (!multi)
+        {
+            if (!start_engine(max_in_flight)) return false;
+            engine_acquired = true;
+        }
+        engine_users++;
+        return true;
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        if (engine_users == 0) return;
+        engine_users--;
+        if (engine_users == 0 && engine_acquired)
+        {
+            stop_engine();
+            engine_acquired = false;
+        }
+    }
+
+    bool is_running()
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        return multi && !stopping;
+    }
+
+    void set_max_in_flight(const int max_in_flight)
+    {
+        if (max_in_flight < 1) return;
+        max_in_flight_requests = max_in_flight;
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (multi)
+        {
+            curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)max_in_flight);
+            curl_multi_wakeup(multi);
+        }
+    }
+
+    void set_priority_options(const priority p, const priority_options& options)
+    {
+        if (p < 0 || p >= PRIORITY_COUNT) return;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            classes[p].options = options;
+            if (multi) curl_multi_wakeup(multi);
+        }
+    }
+
+    void set_thread_priority(const priority p)
+    {
+        if (p >= 0 && p < PRIORITY_COUNT) thread_priority = p;
+    }
+
+    priority get_thread_priority()
+    {
+        return thread_priority;
+    }
+
+    priority_stats get_priority_stats(const priority p)
+    {
+        if (p < 0 || p >= PRIORITY_COUNT) return priority_stats();
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        priority_stats stats = classes[p].stats;
+        stats.queued = classes[p].queue.size();
+        stats.in_flight = classes[p].in_flight;
+        return stats;
+    }
+
+    // Complete job without sending it
+    static std::future<response> reject(struct async_job* job)
+    {
+        std::future<response> future = job->promise.get_future();
+        response resp;
+        resp.curl_code = CURLE_FAILED_INIT;
+        if (job->callback) job->callback(resp);
+        job->promise.set_value(std::move(resp));
+        delete job;
+        return future;
+    }
+
+    static std::future<response> submit(struct async_job* job)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (!multi || stopping)
+        {
+            lock.unlock();
+            fprintf(stderr, "async request rejected: event-loop not running\n");
+            return reject(job);
+        }
+        std::future<response> future = job->promise.get_future();
+        job->prio = thread_priority;
+        enqueue(job, false);
+        curl_multi_wakeup(multi); // under lock, "stop()" cannot free it meanwhile
+        return future;
+    }
+
+    // Queue several jobs at once, so event-loop starts them together
+    static void submit_all(const std::vector<struct async_job*>& jobs,
+        std::vector<std::future<response>>* futures)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (!multi || stopping)
+        {
+            lock.unlock();
+            fprintf(stderr, "async request rejected: event-loop not running\n");
+            for (struct async_job* job : jobs) futures->push_back(reject(job));
+            return;
+        }
+        for (struct async_job* job : jobs)
+        {
+            futures->push_back(job->promise.get_future());
+            job->prio = thread_priority;
+            enqueue(job, false);
+        }
+        curl_multi_wakeup(multi);
+    }
+
+    int warm_up(const int connections)
+    {
+        int num_requests = std::min(connections, max_in_flight_requests.load());
+        if (num_requests <= 0) return 0;
+
+        std::vector<struct async_job*> jobs;
+        for (int i = 0; i < num_requests; i++)
+        {
+            struct async_job* job = new async_job;
+            build_warm_up_request(get_base_url(), &job->request);
+            jobs.push_back(job);
+        }
+
+        // First request fills shared DNS cache and TLS session for the others
+        std::vector<std::future<response>> futures;
+        futures.push_back(submit(jobs[0]));
+        futures[0].wait();
+        submit_all(std::vector<struct async_job*>(jobs.begin() + 1, jobs.end()), &futures);
+
+        int connected = 0;
+        for (std::future<response>& future : futures)
+        {
+            if (future.get().success) connected++;
+        }
+        return connected;
+    }
+
+    std::future<response> submit_request(const struct http_request& request,
+        const metrics::operation op, completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = op;
+        job->request = request;
+        return submit(job);
+    }
+
+    std::future<response> create_layer(const char* layer_name, const char* layer_title,
+        const char* postgis_table_name, const char* filter,
+        const char* workspace, const char* datastore,
+        const bool advertised, completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_CREATE_LAYER;
+        if (!build_create_layer_request(get_base_url(), layer_name, layer_title,
+            postgis_table_name, filter, workspace, datastore, advertised, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> add_style(const char* layer_name, const char* style_name,
+        const char* layer_workspace, const char* style_workspace,
+        completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_ADD_STYLE;
+        if (!build_add_style_request(get_base_url(), layer_name, style_name,
+            layer_workspace, style_workspace, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> create_layer_group(const char* layer_group_name,
+        const char* layer_title, const char* const layer_structure,
+        const char* workspace, const bool advertised,
+        completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_CREATE_LAYER_GROUP;
+        if (!build_create_layer_group_request(get_base_url(), layer_group_name,
+            layer_title, layer_structure, NULL, workspace, advertised, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> create_layer_group(const char* layer_group_name,
+        const char* layer_title, const layer_group_builder& layers,
+        const char* workspace, const bool advertised,
+        completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_CREATE_LAYER_GROUP;
+        if (layers.size() == 0 ||
+            !build_create_layer_group_request(get_base_url(), layer_group_name,
+            layer_title, layers.publishables().c_str(), layers.styles().c_str(),
+            workspace, advertised, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> update_layer_group(const char* layer_group_name,
+        const char* layer_title, const layer_group_builder& layers,
+        const char* workspace, const bool advertised,
+        completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_UPDATE_LAYER_GROUP;
+        if (layers.size() == 0 ||
+            !build_update_layer_group_request(get_base_url(), layer_group_name,
+            layer_title, layers.publishables().c_str(), layers.styles().c_str(),
+            workspace, advertised, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> delete_layer(const char* layer_name, const char* workspace,
+        const char* datastore, completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_DELETE;
+        if (!build_delete_layer_request(get_base_url(), layer_name, workspace,
+            datastore, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> delete_layer_group(const char* layer_group_name,
+        const char* workspace, completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_DELETE;
+        if (!build_delete_layer_group_request(get_base_url(), layer_group_name,
+            workspace, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> get_layer_groups(const char* workspace,
+        completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_GET_DETAILS;
+        job->parse_layers = true;
+        job->format = FORMAT_XML;
+        job->filter_workspace = true;
+        if (!build_get_layer_groups_request(get_base_url(), workspace, &job->request))
+        {
+            return reject(job);
+        }
+        job->workspace = workspace;
+        return submit(job);
+    }
+
+    std::future<response> get_layer_details(const char* layer_name,
+        const char* workspace, completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_GET_DETAILS;
+        if (!build_get_layer_request(get_base_url(), layer_name, workspace, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> get_layer_group_details(const char* layer_group_name,
+        const char* workspace, completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_GET_DETAILS;
+        if (!build_get_layer_group_request(get_base_url(), layer_group_name, workspace,
+            &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+    std::future<response> get_layers(const char* workspace,
+        completion_callback callback)
+    {
+        struct async_job* job = new async_job;
+        job->callback = callback;
+        job->operation = metrics::OP_GET_LAYERS;
+        job->parse_layers = true;
+        job->format = get_catalog_format();
+        if (workspace)
+        {
+            job->filter_workspace = true;
+            job->workspace = workspace;
+        }
+        if (!build_get_layers_request(get_base_url(), workspace, job->format, &job->request))
+        {
+            return reject(job);
+        }
+        return submit(job);
+    }
+
+} // end: namespace async
+} // end: namespace geoserver_api
@@ -0,0 +1,283 @@
+#ifndef GEOSERVER_ASYNC_HPP
+#define GEOSERVER_ASYNC_HPP
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <future>
+#include <functional>
+
+#include <curl/curl.h>
+
+#include "geoserver_curl_wrapper.hpp"
+#include "geoserver_metrics.hpp"
+
+/** Non-blocking versions of "geoserver_curl_wrapper" API functions.
+ * Requests are executed by single event-loop thread using curl_multi
+ * interface, so many requests can be on the wire at once without
+ * thread per request. "geoserver_api::init()" must be called before
+ * "start()" and "cleanup()" only after "stop()". Queued requests are
+ * scheduled by priority class with weighted fair queuing, so interactive
+ * calls do not wait behind bulk jobs.
+ */
+
+namespace geoserver_api
+{
+namespace async
+{
+    /**
+     * @brief Result of asynchronous request
+     */
+    struct response
+    {
+        bool success = false; // wether CURL transfer succeeded
+        CURLcode curl_code = CURLE_OK;
+        long http_code = 0;
+        std::string body;
+        std::vector<std::string> layer_names; // filled by "get_layers()", "get_layer_groups()"
+        struct metrics::request_timing timing;
+    };
+
+    /**
+     * @brief Callback called from event-loop thread when request completes.
+     * It must not block, as it delays all other requests.
+     */
+    typedef std::function<void(const response&)> completion_callback;
+
+    /**
+     * @brief Priority class of request. Every class has its own queue,
+     * queues get slots on the wire in proportion to their weights.
+     */
+    enum priority
+    {
+        PRIORITY_INTERACTIVE, // default, single calls someone waits for
+        PRIORITY_BULK, // "batch::provision()", "reconcile::run()"
+        PRIORITY_COUNT
+    };
+
+    struct priority_options
+    {
+        int weight = 1; // share of free slots while several classes are queued
+        int max_in_flight = 0; // requests of class on the wire, 0 for engine limit
+    };
+
+    /**
+     * @brief Scheduler counters of single priority class since "start()"
+     */
+    struct priority_stats
+    {
+        size_t queued = 0; // waiting now
+        int in_flight = 0; // on the wire now
+        uint64_t started = 0; // requests sent, retries included
+        double queue_wait_s = 0; // sum of queue waits of sent requests
+        double max_queue_wait_s = 0;
+    };
+
+    /**
+     * @brief Change weight and in-flight limit of class. Defaults are weight 4
+     * for PRIORITY_INTERACTIVE and 1 for PRIORITY_BULK without class limits.
+     * Limiting PRIORITY_BULK below "max_in_flight" keeps slots free for
+     * interactive requests.
+     */
+    void set_priority_options(const priority p, const priority_options& options);
+
+    /**
+     * @brief Priority of requests submitted by calling thread, default
+     * PRIORITY_INTERACTIVE. Requests submitted from completion callback
+     * inherit priority of completed request.
+     */
+    void set_thread_priority(const priority p);
+    priority get_thread_priority();
+
+    /**
+     * @brief Set priority of calling thread for lifetime of scope
+     */
+    class priority_scope
+    {
+    public:
+        explicit priority_scope(const priority p) : previous(get_thread_priority())
+        {
+            set_thread_priority(p);
+        }
+        ~priority_scope() { set_thread_priority(previous); }
+
+        priority_scope(const priority_scope&) = delete;
+        priority_scope& operator=(const priority_scope&) = delete;
+
+    private:
+        priority previous;
+    };
+
+    /**
+     * @brief Scheduler counters of class. Queue wait of single request is in
+     * "response::timing.queue_s", network time in the other timing fields.
+     */
+    priority_stats get_priority_stats(const priority p);
+
+    /**
+     * @brief Start event-loop thread.
+     * 
+     * @param max_in_flight maximum number of requests on the wire at once.
+     * Other requests wait in queue.
+     * 
+     * @returns boolean to indicate wether success or not
+     */
+    bool start(const int max_in_flight=32);
+
+    /**
+     * @brief Wait for all queued requests to complete and stop event-loop thread.
+     */
+    void stop();
+
+    /**
+     * @brief Check wether event-loop thread is running
+     */
+    bool is_running();
+
+    /**
+     * @brief Use event-loop from library helper, safe from several threads.
+     * Starts event-loop if it is not running, it then stops on last
+     * "release()". Event-loop started with "start()" is only shared and
+     * must not be stopped while it is acquired.
+     * 
+     * @param max_in_flight used only if event-loop is started here
+     * 
+     * @returns boolean to indicate wether event-loop is running
+     */
+    bool acquire(const int max_in_flight=32);
+
+    /**
+     * @brief End use of "acquire()", waits for queued requests if it
+     * stops event-loop.
+     */
+    void release();
+
+    /**
+     * @brief Change maximum number of requests on the wire at once.
+     */
+    void set_max_in_flight(const int max_in_flight);
+
+    /**
+     * @brief Open event-loop connections ahead of time, see
+     * "geoserver_api::warm_up()". Blocks until warm-up requests complete.
+     * 
+     * @param connections number of parallel requests, at most "max_in_flight".
+     * With HTTP/2 they share one connection.
+     * 
+     * @returns number of successful requests
+     */
+    int warm_up(const int connections);
+
+    /**
+     * @brief Non-blocking "geoserver_api::create_layer()".
+     * 
+     * @param callback optional callback called on completion
+     * 
+     * @returns future with response. HTTP status code 201 on success
+     */
+    std::future<response> create_layer(const char* layer_name, const char* layer_title,
+        const char* postgis_table_name, const char* filter=NULL,
+        const char* workspace="forestAI", const char* datastore="postgis",
+        const bool advertised=true, completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::add_style()".
+     * 
+     * @param callback optional callback called on completion
+     * 
+     * @returns future with response. HTTP status code 200 on success
+     */
+    std::future<response> add_style(const char* layer_name, const char* style_name,
+        const char* layer_workspace="forestAI", const char* style_workspace="forestAI",
+        completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::create_layer_group()".
+     * 
+     * @param callback optional callback called on completion
+     * 
+     * @returns future with response. HTTP status code 201 on success
+     */
+    std::future<response> create_layer_group(const char* layer_group_name,
+        const char* layer_title, const char* const layer_structure,
+        const char* workspace="forestAI", const bool advertised=true,
+        completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::create_layer_group()" with
+     * "layer_group_builder". Layers are serialized before return, so
+     * "layers" can be changed right away.
+     * 
+     * @returns future with response. HTTP status code 201 on success
+     */
+    std::future<response> create_layer_group(const char* layer_group_name,
+        const char* layer_title, const layer_group_builder& layers,
+        const char* workspace="forestAI", const bool advertised=true,
+        completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::update_layer_group()".
+     * 
+     * @returns future with response. HTTP status code 200 on success
+     */
+    std::future<response> update_layer_group(const char* layer_group_name,
+        const char* layer_title, const layer_group_builder& layers,
+        const char* workspace="forestAI", const bool advertised=true,
+        completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::delete_layer()".
+     * 
+     * @returns future with response. HTTP status code 200 on success
+     */
+    std::future<response> delete_layer(const char* layer_name,
+        const char* workspace="forestAI", const char* datastore="postgis",
+        completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::delete_layer_group()".
+     * 
+     * @returns future with response. HTTP status code 200 on success
+     */
+    std::future<response> delete_layer_group(const char* layer_group_name,
+        const char* workspace="forestAI", completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::get_layer_groups()". Layer group
+     * names are returned in "response::layer_names".
+     * 
+     * @returns future with response. HTTP status code 200 on success
+     */
+    std::future<response> get_layer_groups(const char* workspace,
+        completion_callback callback=nullptr);
+
+    /**
+     * @brief Get XML document of single layer (with its default style) or
+     * layer group (with its layers and styles) in "response::body".
+     * 
+     * @returns future with response. HTTP status code 200 on success,
+     * 404 if resource does not exist
+     */
+    std::future<response> get_layer_details(const char* layer_name,
+        const char* workspace="forestAI", completion_callback callback=nullptr);
+    std::future<response> get_layer_group_details(const char* layer_group_name,
+        const char* workspace="forestAI", completion_callback callback=nullptr);
+
+    /**
+     * @brief Non-blocking "geoserver_api::get_layers()". Layer names are
+     * returned in "response::layer_names".
+     * 
+     * @param workspace determine which workspace layers to return.
+     * If NULL, returns all layers.
+     * @param callback optional callback called on completion
+     * 
+     * @returns future with response. HTTP status code 200 on success
+     */
+    std::future<response> get_layers(const char* workspace,
+        completion_callback callback=nullptr);
+
+} // end: namespace async
+} // end: namespace geoserver_api
+
+#endif
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "geoserver_batch.hpp"
+#include "geoserver_async.hpp"
+
+namespace geoserver_api
+{
+namespace batch
+{
+    typedef std::chrono::steady_clock batch_clock;
+
+    // Dependency graph node, one per manifest item
+    struct batch_node
+    {
+        std::vector<size_t> dependents;
+        int pending_dependencies = 0;
+        bool invalid = false; // failed without request, see "provision()"
+        batch_clock::time_point start;
+    };
+
+    // State shared between caller and event-loop callbacks
+    struct batch_run
+    {
+        const manifest* items;
+        std::vector<struct batch_node> nodes;
+        result table;
+        std::vector<layer_group_builder> group_structures;
+        batch_clock::time_point start;
+
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        size_t remaining = 0;
+    };
+
+    static double elapsed_ms(batch_clock::time_point from, batch_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    static void complete(struct batch_run* run, size_t node_idx,
+        const async::response* resp);
+
+    // Send request of single node, completion is reported to "complete()"
+    static void launch(struct batch_run* run, size_t node_idx)
+    {
+        struct item_result& item = run->table.items[node_idx];
+        run->nodes[node_idx].start = batch_clock::now();
+        async::completion_callback callback = [run, node_idx](const async::response& resp)
+        {
+            complete(run, node_idx, &resp);
+        };
+
+        switch (item.type)
+        {
+            case ITEM_LAYER:
+            {
+                const layer_spec& spec = run->items->layers[item.index];
+                async::create_layer(spec.layer_name.c_str(), spec.layer_title.c_str(),
+                    spec.postgis_table_name.c_str(),
+                    (spec.filter.empty()) ? NULL : spec.filter.c_str(),
+                    spec.workspace.c_str(), spec.datastore.c_str(), spec.advertised,
+                    callback);
+                break;
+            }
+            case ITEM_STYLE:
+            {
+                const style_spec& spec = run->items->styles[item.index];
+                async::add_style(spec.layer_name.c_str(), spec.style_name.c_str(),
+                    spec.layer_workspace.c_str(), spec.style_workspace.c_str(),
+                    callback);
+                break;
+            }
+            case ITEM_GROUP:
+            {
+                if (run->nodes[node_idx].invalid)
+                {
+                    async::response rejected;
+                    rejected.curl_code = CURLE_FAILED_INIT;
+                    complete(run, node_idx, &rejected);
+                    break;
+                }
+                const group_spec& spec = run->items->groups[item.index];
+                async::create_layer_group(spec.layer_group_name.c_str(),
+                    spec.layer_title.c_str(), run->group_structures[item.index],
+                    spec.workspace.c_str(), spec.advertised, callback);
+                break;
+            }
+        }
+    }
+
+    /**
+     * Record result of node and launch dependents which became ready.
+     * If "resp" is NULL, node was skipped because dependency failed.
+     */
+    static void complete(struct batch_run* run, size_t node_idx,
+        const async::response* resp)
+    {
+        std::vector<size_t> ready;
+        {
+            std::lock_guard<std::mutex> lock(run->mutex);
+            batch_clock::time_point now = batch_clock::now();
+
+            // Skipped dependents are completed here, without recursion
+            std::vector<std::pair<size_t, const async::response*>> stack;
+            stack.emplace_back(node_idx, resp);
+            while (!stack.empty())
+            {
+                size_t idx = stack.back().first;
+                const async::response* r = stack.back().second;
+                stack.pop_back();
+
+                struct item_result& item = run->table.items[idx];
+                if (r)
+                {
+                    item.http_code = r->http_code;
+                    item.success = r->success && r->http_code >= 200 && r->http_code < 300;
+                    item.start_ms = elapsed_ms(run->start, run->nodes[idx].start);
+                    item.duration_ms = elapsed_ms(run->nodes[idx].start, now);
+                }
+                else
+                {
+                    item.skipped = true;
+                    item.start_ms = elapsed_ms(run->start, now);
+                }
+                run->remaining--;
+
+                for (size_t dependent : run->nodes[idx].dependents)
+                {
+                    if (!item.success)
+                    {
+                        // Dependent may already be skipped by other failed dependency
+                        if (run->nodes[dependent].pending_dependencies > 0)
+                        {
+                            run->nodes[dependent].pending_dependencies = 0;
+                            stack.emplace_back(dependent, nullptr);
+                        }
+                    }
+                    else if (--run->nodes[dependent].pending_dependencies == 0)
+                    {
+                        ready.push_back(dependent);
+                    }
+                }
+            }
+            if (run->remaining == 0) run->done_cv.notify_all();
+        }
+
+        for (size_t idx : ready) launch(run, idx);
+    }
+
+    result provision(const manifest& items)
+    {
+        struct batch_run run;
+        run.items = &items;
+        run.start = batch_clock::now();
+
+        size_t total = items.layers.size() + items.styles.size() + items.groups.size();
+        run.nodes.resize(total);
+        run.table.items.resize(total);
+        run.remaining = total;
+        if (total == 0)
+        {
+            run.table.all_success = true;
+            return run.table;
+        }
+
+        // Build dependency graph
+        std::map<std::string, size_t> layer_nodes; // "{workspace}:{layer}" -> node
+        size_t node_idx = 0;
+        for (size_t i = 0; i < items.layers.size(); i++, node_idx++)
+        {
+            const layer_spec& spec = items.layers[i];
+            struct item_result& item = run.table.items[node_idx];
+            item.type = ITEM_LAYER;
+            item.index = i;
+            item.name = spec.workspace + ":" + spec.layer_name;
+            layer_nodes[item.name] = node_idx;
+        }
+        auto depend_on_layer = [&](const std::string& layer, size_t dependent)
+        {
+            auto it = layer_nodes.find(layer);
+            if (it == layer_nodes.end()) return; // expected to exist in Geoserver
+            run.nodes[it->second].dependents.push_back(dependent);
+            run.nodes[dependent].pending_dependencies++;
+        };
+        for (size_t i = 0; i < items.styles.size(); i++, node_idx++)
+        {
+            const style_spec& spec = items.styles[i];
+            struct item_result& item = run.table.items[node_idx];
+            item.type = ITEM_STYLE;
+            item.index = i;
+            item.name = spec.layer_workspace + ":" + spec.layer_name;
+            depend_on_layer(item.name, node_idx);
+        }
+        run.group_structures.resize(items.groups.size());
+        for (size_t i = 0; i < items.groups.size(); i++, node_idx++)
+        {
+            const group_spec& spec = items.groups[i];
+            struct item_result& item = run.table.items[node_idx];
+            item.type = ITEM_GROUP;
+            item.index = i;
+            item.name = spec.workspace + ":" + spec.layer_group_name;
+            bool valid = true;
+            for (const std::string& layer : spec.layer_names)
+            {
+                valid = run.group_structures[i].add(spec.workspace.c_str(), layer.c_str()) &&
+                    valid;
+            }
+            if (!valid)
+            {
+                // Incomplete group is not sent, it fails without waiting for its layers
+                fprintf(stderr, "batch::provision(): layer group %s has invalid layer\n",
+                    item.name.c_str());
+                run.nodes[node_idx].invalid = true;
+                continue;
+            }
+            for (const std::string& layer : spec.layer_names)
+            {
+                depend_on_layer(spec.workspace + ":" + layer, node_idx);
+            }
+        }
+
+        if (!async::acquire())
+        {
+            fprintf(stderr, "batch::provision(): async::acquire() failed\n");
+            return run.table;
+        }
+
+        // Launch all items without dependencies, others follow from callbacks
+        // and inherit bulk priority
+        async::priority_scope scope(async::PRIORITY_BULK);
+        std::vector<size_t> roots;
+        for (size_t i = 0; i < total; i++)
+        {
+            if (run.nodes[i].pending_dependencies == 0) roots.push_back(i);
+        }
+        for (size_t idx : roots) launch(&run, idx);
+
+        {
+            std::unique_lock<std::mutex> lock(run.mutex);
+            run.done_cv.wait(lock, [&run]{ return run.remaining == 0; });
+        }
+        async::release();
+
+        run.table.total_ms = elapsed_ms(run.start, batch_clock::now());
+        run.table.all_success = true;
+        for (const struct item_result& item : run.table.items)
+        {
+            if (!item.success) run.table.all_success = false;
+        }
+        return run.table;
+    }
+
+} // end: namespace batch
+} // end: namespace geoserver_api
@@ -0,0 +1,106 @@
+#ifndef GEOSERVER_BATCH_HPP
+#define GEOSERVER_BATCH_HPP
+
+#include <string>
+#include <vector>
+
+/** Bulk provisioning of layers, styles and layer groups. Items are
+ * executed with "geoserver_async.hpp" engine, independent items run
+ * in parallel and dependent ones (style after its layer, group after
+ * its layers) start as soon as their dependencies succeed.
+ */
+
+namespace geoserver_api
+{
+namespace batch
+{
+    /**
+     * @brief Layer to create, see "geoserver_api::create_layer()"
+     */
+    struct layer_spec
+    {
+        std::string layer_name;
+        std::string layer_title;
+        std::string postgis_table_name;
+        std::string filter; // empty for no CQL filter
+        std::string workspace = "forestAI";
+        std::string datastore = "postgis";
+        bool advertised = true;
+    };
+
+    /**
+     * @brief Style to add to layer, see "geoserver_api::add_style()"
+     */
+    struct style_spec
+    {
+        std::string layer_name;
+        std::string style_name;
+        std::string layer_workspace = "forestAI";
+        std::string style_workspace = "forestAI";
+    };
+
+    /**
+     * @brief Layer group to create, see "geoserver_api::create_layer_group()".
+     * All layers are expected to be in group workspace.
+     */
+    struct group_spec
+    {
+        std::string layer_group_name;
+        std::string layer_title;
+        std::vector<std::string> layer_names;
+        std::string workspace = "forestAI";
+        bool advertised = true;
+    };
+
+    struct manifest
+    {
+        std::vector<layer_spec> layers;
+        std::vector<style_spec> styles;
+        std::vector<group_spec> groups;
+    };
+
+    enum item_type
+    {
+        ITEM_LAYER,
+        ITEM_STYLE,
+        ITEM_GROUP
+    };
+
+    /**
+     * @brief Outcome of single manifest item
+     */
+    struct item_result
+    {
+        item_type type;
+        size_t index; // index in corresponding manifest vector
+        std::string name;
+        bool success = false; // transfer succeeded and HTTP status code is 2xx
+        bool skipped = false; // not sent, because dependency failed
+        long http_code = 0;
+        double start_ms = 0; // since start of batch
+        double duration_ms = 0;
+    };
+
+    struct result
+    {
+        std::vector<item_result> items; // layers, then styles, then groups
+        bool all_success = false;
+        double total_ms = 0;
+    };
+
+    /**
+     * @brief Create all manifest items, running independent ones in parallel.
+     * Holds async engine with "async::acquire()", so concurrent calls share it.
+     * Blocks until all items are done. Requests are sent in
+     * "async::PRIORITY_BULK" class.
+     * 
+     * @param items layers, styles and groups to create
+     * 
+     * @returns per-item result table
+     */
+    result provision(const manifest& items);
+
+} // end: namespace batch
+} // end: namespace geoserver_api
+
+#endif
@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+#include <unordered_set>
+#include <condition_variable>
+
+#include "geoserver_curl_wrapper.hpp"
+#include "geoserver_internal.hpp"
+
+namespace geoserver_api
+{
+    typedef std::chrono::steady_clock cache_clock;
+
+    /**
+     * Snapshot file layout: header, "count" offsets of names sorted by name,
+     * ETag, Last-Modified, base url and pool of \0 terminated names.
+     * Integers are in host byte order, file is used only on same machine.
+     */
+    struct snapshot_header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint64_t pool_size;
+        uint32_t etag_len;
+        uint32_t last_modified_len;
+        uint32_t url_len;
+        uint32_t reserved;
+    };
+
+    static const char snapshot_magic[8] = {'G', 'S', 'C', 'A', 'T', 'L', 'G', 0};
+    static const uint32_t snapshot_version = 1;
+
+    // Layer list mapped from snapshot file
+    struct mapped_snapshot
+    {
+        void* map = NULL;
+        size_t map_size = 0;
+        const uint64_t* offsets = NULL; // sorted by name
+        const char* pool = NULL;
+        size_t count = 0;
+    };
+
+    // Full (not filtered by workspace) layer list of Geoserver
+    struct catalog_cache
+    {
+        bool enabled = false;
+        cache_clock::duration ttl;
+
+        bool valid = false;
+        cache_clock::time_point fetched;
+        unsigned long generation = 0; // incremented by every invalidation
+        struct catalog_validators validators;
+        struct layer_list layers;
+        std::unordered_set<std::string_view> index; // views into "layers" arena
+
+        // Used instead of "layers" until first download, see "enable_catalog_snapshot()"
+        struct mapped_snapshot snapshot;
+        std::string snapshot_path; // empty - snapshot is not written
+        long revalidation_code = 0; // HTTP code of background revalidation
+
+        // Single download at a time, other threads wait for its result
+        bool revalidating = false;
+        unsigned long revalidating_generation = 0;
+        unsigned long revalidations = 0; // finished downloads
+        bool revalidated_status = false;
+        long revalidated_code = 0;
+    };
+
+    // global variables
+    static std::mutex cache_mutex;
+    static std::condition_variable cache_cv; // end of revalidation
+    static struct catalog_cache cache;
+    static std::thread revalidation_thread;
+    static std::mutex revalidation_mutex; // protects "revalidation_thread"
+
+    // Expects locked "cache_mutex"
+    static size_t cached_count()
+    {
+        return (cache.snapshot.map) ? cache.snapshot.count : cache.layers.size();
+    }
+
+    // Expects locked "cache_mutex"
+    static const char* cached_name(size_t idx)
+    {
+        return (cache.snapshot.map) ? cache.snapshot.pool + cache.snapshot.offsets[idx] :
+            cache.layers[idx];
+    }
+
+    // Expects locked "cache_mutex"
+    static void release_snapshot()
+    {
+        if (cache.snapshot.map) munmap(cache.snapshot.map, cache.snapshot.map_size);
+        cache.snapshot = mapped_snapshot();
+    }
+
+    static void rebuild_index()
+    {
+        cache.index.clear();
+        cache.index.reserve(cache.layers.size());
+        for (size_t i = 0; i < cache.layers.size(); i++)
+        {
+            cache.index.emplace(cache.layers[i]);
+        }
+    }
+
+    // Expects locked "cache_mutex"
+    static bool copy_layers(const char* workspace, struct layer_list* to)
+    {
+        size_t workspace_len = (workspace) ? strlen(workspace) : 0;
+        to->clear();
+        for (size_t i = 0; i < cached_count(); i++)
+        {
+            const char* name = cached_name(i);
+            if (workspace && (strncmp(workspace, name, workspace_len) != 0 ||
+                name[workspace_len] != ':'))
+            {
+                continue;
+            }
+            if (!to->push_back(name))
+            {
+                fprintf(stderr, "Failed realloc\n");
+                to->clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool store_layer_name(const char* name, void* user_data)
+    {
+        return ((struct layer_list*)user_data)->push_back(name);
+    }
+
+    static bool write_all(int fd, const void* data, size_t len)
+    {
+        const char* p = (const char*)data;
+        while (len > 0)
+        {
+            ssize_t written = write(fd, p, len);
+            if (written <= 0) return false;
+            p += written;
+            len -= written;
+        }
+        return true;
+    }
+
+    /**
+     * Write "layers" to "tmp_path" and flush it to disk. Caller renames it
+     * over snapshot file, so readers (and mapping of old file) see complete file.
+     */
+    static bool write_snapshot(const std::string& tmp_path, const struct layer_list& layers,
+        const struct catalog_validators& validators)
+    {
+        std::vector<uint64_t> offsets(layers.size());
+        for (size_t i = 0; i < layers.size(); i++) offsets[i] = layers.offsets.p[i];
+        std::sort(offsets.begin(), offsets.end(), [&layers](uint64_t a, uint64_t b)
+        {
+            return strcmp(layers.names.p + a, layers.names.p + b) < 0;
+        });
+
+        struct snapshot_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+        header.version = snapshot_version;
+        header.count = layers.size();
+        header.pool_size = layers.names.length;
+        header.etag_len = validators.etag.size();
+        header.last_modified_len = validators.last_modified.size();
+        header.url_len = strlen(get_base_url());
+
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            perror("write_snapshot() open");
+            return false;
+        }
+        bool status = write_all(fd, &header, sizeof(header)) &&
+            write_all(fd, offsets.data(), offsets.size() * sizeof(uint64_t)) &&
+            write_all(fd, validators.etag.data(), header.etag_len) &&
+            write_all(fd, validators.last_modified.data(), header.last_modified_len) &&
+            write_all(fd, get_base_url(), header.url_len) &&
+            write_all(fd, layers.names.p, header.pool_size);
+        // Crash after rename must not leave empty file in place of old snapshot
+        status = status && fsync(fd) == 0;
+        status = (close(fd) == 0) && status;
+        if (!status) unlink(tmp_path.c_str());
+        return status;
+    }
+
+    /**
+     * Map snapshot file and check its layout. Snapshot of other Geoserver
+     * (different base url) is rejected.
+     */
+    static bool map_snapshot(const char* path, struct mapped_snapshot* snapshot,
+        struct catalog_validators* validators)
+    {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return false; // no snapshot yet
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(snapshot_header))
+        {
+            close(fd);
+            return false;
+        }
+        size_t map_size = file_stat.st_size;
+        void* map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+        {
+            perror("map_snapshot() mmap");
+            return false;
+        }
+
+        const struct snapshot_header* header = (const struct snapshot_header*)map;
+        const char* data = (const char*)map + sizeof(snapshot_header);
+        uint64_t expected = sizeof(snapshot_header) + (uint64_t)header->count * sizeof(uint64_t) +
+            header->etag_len + header->last_modified_len + header->url_len + header->pool_size;
+        const char* url = data + header->count * sizeof(uint64_t) + header->etag_len +
+            header->last_modified_len;
+        const char* pool = url + header->url_len;
+        bool valid = memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) == 0 &&
+            header->version == snapshot_version && expected == map_size &&
+            header->url_len == strlen(get_base_url()) &&
+            memcmp(url, get_base_url(), header->url_len) == 0 &&
+            (header->pool_size == 0 || pool[header->pool_size - 1] == 0);
+
+        // Every name must end inside pool
+        const uint64_t* offsets = (const uint64_t*)data;
+        for (uint32_t i = 0; valid && i < header->count; i++)
+        {
+            valid = offsets[i] < header->pool_size;
+        }
+        if (!valid)
+        {
+            fprintf(stderr, "map_snapshot(): %s is not valid snapshot of this Geoserver\n", path);
+            munmap(map, map_size);
+            return false;
+        }
+
+        snapshot->map = map;
+        snapshot->map_size = map_size;
+        snapshot->offsets = offsets;
+        snapshot->pool = pool;
+        snapshot->count = header->count;
+        const char* etag = data + header->count * sizeof(uint64_t);
+        validators->etag.assign(etag, header->etag_len);
+        validators->last_modified.assign(etag + header->etag_len, header->last_modified_len);
+        return true;
+    }
+
+    /**
+     * Revalidate cached list with conditional GET or download it, if there is
+     * no valid list. Expects locked "cache_mutex", which is released during request.
+     */
+    static bool revalidate_cache(std::unique_lock<std::mutex>& lock)
+    {
+        // Share download in progress, unless it was started before write
+        while (cache.revalidating)
+        {
+            bool joined = cache.revalidating_generation == cache.generation;
+            unsigned long round = cache.revalidations;
+            cache_cv.wait(lock, [round]{ return cache.revalidations != round; });
+            if (joined)
+            {
+                set_last_http_code(cache.revalidated_code);
+                return cache.revalidated_status;
+            }
+        }
+        cache.revalidating = true;
+        cache.revalidating_generation = cache.generation;
+        cache_clock::time_point now = cache_clock::now();
+
+        // Revalidate only list, which was not invalidated by write
+        struct catalog_validators validators;
+        if (cache.valid) validators = cache.validators;
+        unsigned long generation = cache.generation;
+        std::string snapshot_path = cache.snapshot_path;
+        lock.unlock();
+
+        struct layer_list fresh;
+        bool not_modified = false;
+        bool status = stream_layers(NULL, store_layer_name, &fresh, &validators,
+            &not_modified);
+
+        // Snapshot is written without lock, cache is served meanwhile
+        std::string tmp_path = snapshot_path + ".tmp";
+        bool written = status && !not_modified && !snapshot_path.empty() &&
+            write_snapshot(tmp_path, fresh, validators);
+        lock.lock();
+
+        if (written)
+        {
+            // List downloaded before write or for disabled snapshot is dropped
+            bool current = generation == cache.generation && snapshot_path == cache.snapshot_path;
+            if (current && rename(tmp_path.c_str(), snapshot_path.c_str()) != 0)
+            {
+                perror("revalidate_cache() rename");
+                current = false;
+            }
+            if (!current) unlink(tmp_path.c_str());
+        }
+        if (status && !not_modified)
+        {
+            release_snapshot();
+            free_layer_list(&cache.layers);
+            cache.layers = fresh;
+            fresh = layer_list();
+            cache.validators = validators;
+            rebuild_index();
+        }
+        // List requested before write may miss it, use it only for this call
+        if (status && generation == cache.generation)
+        {
+            cache.valid = true;
+            cache.fetched = now;
+        }
+        free_layer_list(&fresh);
+
+        cache.revalidating = false;
+        cache.revalidations++;
+        cache.revalidated_status = status;
+        cache.revalidated_code = get_http_response_code();
+        cache_cv.notify_all();
+        return status;
+    }
+
+    /**
+     * Make sure cache holds fresh layer list. Expects locked "cache_mutex",
+     * which is released during request.
+     */
+    static bool refresh_cache(std::unique_lock<std::mutex>& lock)
+    {
+        if (cache.valid && cache_clock::now() - cache.fetched < cache.ttl)
+        {
+            set_last_http_code(200);
+            return true;
+        }
+        return revalidate_cache(lock);
+    }
+
+    bool catalog_cache_enabled()
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return cache.enabled;
+    }
+
+    void enable_catalog_cache(const int ttl_s)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.enabled = true;
+        cache.ttl = std::chrono::seconds(ttl_s);
+    }
+
+    void disable_catalog_cache()
+    {
+        disable_catalog_snapshot();
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.enabled = false;
+        cache.valid = false;
+        cache.generation++;
+        cache.index.clear();
+        free_layer_list(&cache.layers);
+        release_snapshot();
+        cache.validators = catalog_validators();
+    }
+
+    bool enable_catalog_snapshot(const char* path)
+    {
+        wait_catalog_revalidation();
+        std::lock_guard<std::mutex> thread_lock(revalidation_mutex);
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            if (!cache.enabled)
+            {
+                fprintf(stderr, "enable_catalog_snapshot(): catalog cache is not enabled\n");
+                return false;
+            }
+            cache.snapshot_path = path;
+            cache.revalidation_code = 0;
+            if (cache.valid) return false; // keep downloaded list
+
+            struct mapped_snapshot snapshot;
+            struct catalog_validators validators;
+            if (!map_snapshot(path, &snapshot, &validators)) return false;
+
+            release_snapshot();
+            free_layer_list(&cache.layers);
+            cache.index.clear();
+            cache.snapshot = snapshot;
+            cache.validators = validators;
+            cache.valid = true;
+            cache.fetched = cache_clock::now();
+        }
+
+        // Serve snapshot right away, check it against Geoserver meanwhile
+        revalidation_thread = std::thread([]
+        {
+            std::unique_lock<std::mutex> lock(cache_mutex);
+            bool status = cache.valid && revalidate_cache(lock);
+            cache.revalidation_code = (status) ? get_http_response_code() : 0;
+        });
+        return true;
+    }
+
+    long wait_catalog_revalidation()
+    {
+        {
+            std::lock_guard<std::mutex> thread_lock(revalidation_mutex);
+            if (revalidation_thread.joinable()) revalidation_thread.join();
+        }
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return cache.revalidation_code;
+    }
+
+    void disable_catalog_snapshot()
+    {
+        wait_catalog_revalidation();
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.snapshot_path.clear();
+    }
+
+    unsigned long catalog_generation()
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return cache.generation;
+    }
+
+    void invalidate_catalog_cache()
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache.valid = false;
+        cache.generation++;
+    }
+
+    bool cached_get_layers(const char* workspace, struct layer_list* layers)
+    {
+        std::unique_lock<std::mutex> lock(cache_mutex);
+        if (!refresh_cache(lock))
+        {
+            layers->clear();
+            return false;
+        }
+        return copy_layers(workspace, layers);
+    }
+
+    bool layer_exists(const char* layer_name, bool* exists)
+    {
+        *exists = false;
+        if (catalog_cache_enabled())
+        {
+            std::unique_lock<std::mutex> lock(cache_mutex);
+            if (!refresh_cache(lock)) return false;
+            if (cache.snapshot.map)
+            {
+                // Names of snapshot are sorted, no index is built
+                const char* pool = cache.snapshot.pool;
+                const uint64_t* end = cache.snapshot.offsets + cache.snapshot.count;
+                const uint64_t* found = std::lower_bound(cache.snapshot.offsets, end,
+                    layer_name, [pool](uint64_t offset, const char* name)
+                    {
+                        return strcmp(pool + offset, name) < 0;
+                    });
+                *exists = found != end && strcmp(pool + *found, layer_name) == 0;
+                return true;
+            }
+            *exists = cache.index.count(layer_name) > 0;
+            return true;
+        }
+
+        struct layer_list layers;
+        bool status = get_layers(NULL, &layers);
+        for (size_t i = 0; status && i < layers.size(); i++)
+        {
+            if (strcmp(layers[i], layer_name) == 0)
+            {
+                *exists = true;
+                break;
+            }
+        }
+        free_layer_list(&layers);
+        return status;
+    }
+
+} // end: namespace geoserver_api
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <functional>
+#include <condition_variable>
+
+#include "geoserver_cluster.hpp"
+#include "geoserver_async.hpp"
+#include "geoserver_internal.hpp"
+
+namespace geoserver_api
+{
+namespace cluster
+{
+    typedef std::chrono::steady_clock cluster_clock;
+    typedef std::function<bool(const char* base_url, struct http_request* request)>
+        request_builder;
+
+    // Shared by caller and event-loop callbacks, outlives early quorum return
+    struct fan_out_state
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        write_result result;
+        size_t done = 0;
+        size_t failed = 0;
+        cluster_clock::time_point start;
+    };
+
+    struct replica
+    {
+        bool valid = false; // node has base URL
+        double ewma_ms = 0;
+        double error_rate = 0;
+        int in_flight = 0;
+        int consecutive_failures = 0;
+        int samples = 0;
+        cluster_clock::time_point ejected_until;
+        struct replica_stats stats;
+    };
+
+    // Scores of read replicas, shared by copies of client
+    struct replica_set
+    {
+        std::mutex mutex;
+        std::mt19937 rng{std::random_device{}()};
+        size_t next = 0; // round-robin position
+        read_options options;
+        std::vector<replica> replicas;
+    };
+
+    static double elapsed_ms(cluster_clock::time_point from)
+    {
+        return std::chrono::duration<double, std::milli>(cluster_clock::now() - from).count();
+    }
+
+    client::client(const std::vector<node>& nodes, const write_policy policy)
+        : policy(policy), replicas(std::make_shared<replica_set>())
+    {
+        for (const node& address : nodes)
+        {
+            std::string url;
+            if (!make_base_url(address.hostname.c_str(), address.port, &url)) url.clear();
+            base_urls.push_back(url);
+            names.push_back(address.hostname + ":" + std::to_string(address.port));
+
+            replica item;
+            item.valid = !url.empty();
+            item.stats.node = names.back();
+            replicas->replicas.push_back(item);
+        }
+    }
+
+    size_t client::required() const
+    {
+        return (policy == WRITE_ALL) ? base_urls.size() : base_urls.size() / 2 + 1;
+    }
+
+    /**
+     * Send request built by "build" to every node. Returns when all nodes
+     * answered or, with "wait_all" false, when result is already decided.
+     */
+    static write_result fan_out(const std::vector<std::string>& base_urls,
+        const std::vector<std::string>& names, size_t required, bool wait_all,
+        const metrics::operation op, const request_builder& build)
+    {
+        std::shared_ptr<fan_out_state> state = std::make_shared<fan_out_state>();
+        size_t total = base_urls.size();
+        state->start = cluster_clock::now();
+        state->result.nodes.resize(total);
+        for (size_t i = 0; i < total; i++) state->result.nodes[i].node = names[i];
+
+        if (!async::acquire())
+        {
+            fprintf(stderr, "cluster::client: async::acquire() failed\n");
+            return state->result;
+        }
+
+        for (size_t i = 0; i < total; i++)
+        {
+            struct http_request request;
+            if (base_urls[i].empty() || !build(base_urls[i].c_str(), &request))
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->result.nodes[i].done = true;
+                state->done++;
+                state->failed++;
+                continue;
+            }
+            async::submit_request(request, op, [state, i](const async::response& resp)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                struct node_result& result = state->result.nodes[i];
+                result.done = true;
+                result.success = resp.success && resp.http_code >= 200 && resp.http_code < 300;
+                result.http_code = resp.http_code;
+                result.curl_code = resp.curl_code;
+                result.duration_ms = elapsed_ms(state->start);
+                state->done++;
+                if (result.success) state->result.succeeded++;
+                else state->failed++;
+                state->cv.notify_all();
+            });
+        }
+
+        write_result result;
+        {
+            // Quorum is decided once enough nodes succeeded or too many failed
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock, [&]
+            {
+                return state->done == total || (!wait_all &&
+                    (state->result.succeeded >= required || state->failed > total - required));
+            });
+            result = state->result;
+        }
+        result.success = total > 0 && result.succeeded >= required;
+        result.total_ms = elapsed_ms(state->start);
+
+        async::release(); // waits for remaining nodes if it stops engine
+        return result;
+    }
+
+    write_result client::create_layer(const char* layer_name, const char* layer_title,
+        const char* postgis_table_name, const char* filter,
+        const char* workspace, const char* datastore,
+        const bool advertised) const
+    {
+        return fan_out(base_urls, names, required(), policy == WRITE_ALL,
+            metrics::OP_CREATE_LAYER, [&](const char* base_url, struct http_request* request)
+            {
+                return build_create_layer_request(base_url, layer_name, layer_title,
+                    postgis_table_name, filter, workspace, datastore, advertised, request);
+            });
+    }
+
+    write_result client::add_style(const char* layer_name, const char* style_name,
+        const char* layer_workspace, const char* style_workspace) const
+    {
+        return fan_out(base_urls, names, required(), policy == WRITE_ALL,
+            metrics::OP_ADD_STYLE, [&](const char* base_url, struct http_request* request)
+            {
+                return build_add_style_request(base_url, layer_name, style_name,
+                    layer_workspace, style_workspace, request);
+            });
+    }
+
+    write_result client::create_layer_group(const char* layer_group_name,
+        const char* layer_title, const layer_group_builder& layers,
+        const char* workspace, const bool advertised) const
+    {
+        if (layers.size() == 0)
+        {
+            fprintf(stderr, "cluster::client::create_layer_group() layer group has no layers\n");
+            return write_result();
+        }
+        return fan_out(base_urls, names, required(), policy == WRITE_ALL,
+            metrics::OP_CREATE_LAYER_GROUP, [&](const char* base_url, struct http_request* request)
+            {
+                return build_create_layer_group_request(base_url, layer_group_name,
+                    layer_title, layers.publishables().c_str(), layers.styles().c_str(),
+                    workspace, advertised, request);
+            });
+    }
+
+    static double replica_score(const replica& item)
+    {
+        return (item.ewma_ms + 1) * (item.in_flight + 1) * (1 + 10 * item.error_rate);
+    }
+
+    /**
+     * Pick replica for next read, other than "exclude" if possible.
+     * Expired ejections end here, replica starts again with reset score.
+     * Caller must hold lock. Returns -1 if there is no valid replica.
+     */
+    static int pick_replica(replica_set& set, int exclude)
+    {
+        cluster_clock::time_point now = cluster_clock::now();
+        std::vector<int> candidates;
+        for (size_t i = 0; i < set.replicas.size(); i++)
+        {
+            replica& item = set.replicas[i];
+            if (item.stats.ejected && now >= item.ejected_until)
+            {
+                item.stats.ejected = false;
+                item.ewma_ms = 0;
+                item.error_rate = 0;
+                item.samples = 0;
+                item.consecutive_failures = 0;
+            }
+            if (item.valid && !item.stats.ejected && (int)i != exclude) candidates.push_back(i);
+        }
+        // Ejected replica is still better than no read at all
+        for (size_t i = 0; candidates.empty() && i < set.replicas.size(); i++)
+        {
+            if (set.replicas[i].valid && (int)i != exclude) candidates.push_back(i);
+        }
+        for (size_t i = 0; candidates.empty() && i < set.replicas.size(); i++)
+        {
+            if (set.replicas[i].valid) candidates.push_back(i);
+        }
+        if (candidates.empty()) return -1;
+
+        int chosen = candidates[0];
+        if (set.options.selection == SELECT_ROUND_ROBIN)
+        {
+            chosen = candidates[set.next++ % candidates.size()];
+        }
+        else if (candidates.size() > 1)
+        {
+            std::uniform_int_distribution<size_t> dist(0, candidates.size() - 1);
+            size_t a = dist(set.rng);
+            size_t b = dist(set.rng);
+            while (b == a) b = dist(set.rng);
+            chosen = (replica_score(set.replicas[candidates[a]]) <=
+                replica_score(set.replicas[candidates[b]])) ? candidates[a] : candidates[b];
+        }
+        set.replicas[chosen].in_flight++;
+        set.replicas[chosen].stats.reads++;
+        return chosen;
+    }
+
+    /**
+     * Update score of replica "index" with finished read and eject it if it
+     * keeps failing or is much slower than others. Caller must hold lock.
+     */
+    static void report_replica(replica_set& set, int index, bool healthy, double duration_ms)
+    {
+        const read_options& options = set.options;
+        replica& item = set.replicas[index];
+        item.in_flight--;
+
+        // Failed reads are often fast, they must not lower latency
+        if (healthy)
+        {
+            item.ewma_ms = (item.samples) ? item.ewma_ms + options.ewma_weight *
+                (duration_ms - item.ewma_ms) : duration_ms;
+            item.samples++;
+            item.consecutive_failures = 0;
+        }
+        else
+        {
+            item.stats.errors++;
+            item.consecutive_failures++;
+        }
+        item.error_rate += options.ewma_weight * (((healthy) ? 0.0 : 1.0) - item.error_rate);
+        if (item.stats.ejected) return;
+
+        bool eject = options.eject_after_failures > 0 &&
+            item.consecutive_failures >= options.eject_after_failures;
+        if (!eject && options.eject_latency_factor > 0 && item.samples >= options.eject_min_samples)
+        {
+            double fastest = -1;
+            for (size_t i = 0; i < set.replicas.size(); i++)
+            {
+                const replica& other = set.replicas[i];
+                if ((int)i == index || !other.valid || other.stats.ejected ||
+                    other.samples < options.eject_min_samples) continue;
+                if (fastest < 0 || other.ewma_ms < fastest) fastest = other.ewma_ms;
+            }
+            eject = fastest >= 0 && item.ewma_ms > options.eject_latency_factor * (fastest + 1);
+        }
+        if (!eject) return;
+
+        size_t ejected = 0;
+        for (const replica& other : set.replicas) ejected += other.stats.ejected;
+        if ((ejected + 1) * 100 > (size_t)options.max_ejected_percent * set.replicas.size()) return;
+
+        item.stats.ejected = true;
+        item.stats.ejections++;
+        item.ejected_until = cluster_clock::now() + std::chrono::milliseconds(options.eject_ms);
+    }
+
+    static bool append_layer(const char* name, void* user_data)
+    {
+        if (!((struct layer_list*)user_data)->push_back(name))
+        {
+            fprintf(stderr, "Failed realloc\n");
+            return false;
+        }
+        return true;
+    }
+
+    void client::set_read_options(const read_options& options)
+    {
+        std::lock_guard<std::mutex> lock(replicas->mutex);
+        replicas->options = options;
+    }
+
+    bool client::get_layers(const char* workspace, struct layer_list* layers) const
+    {
+        layers->clear();
+        int attempts = 0;
+        {
+            std::lock_guard<std::mutex> lock(replicas->mutex);
+            attempts = (replicas->options.read_attempts > 0) ? replicas->options.read_attempts : 1;
+        }
+
+        int previous = -1;
+        for (int attempt = 0; attempt < attempts; attempt++)
+        {
+            int index;
+            {
+                std::lock_guard<std::mutex> lock(replicas->mutex);
+                index = pick_replica(*replicas, previous);
+            }
+            if (index < 0)
+            {
+                fprintf(stderr, "cluster::client::get_layers() no valid node\n");
+                return false;
+            }
+
+            catalog_format format = get_catalog_format();
+            struct http_request request;
+            bool built = build_get_layers_request(base_urls[index].c_str(), workspace,
+                format, &request);
+            cluster_clock::time_point start = cluster_clock::now();
+            bool sent = built && send_request("cluster::client::get_layers()", request,
+                metrics::OP_GET_LAYERS);
+            double duration_ms = elapsed_ms(start);
+            long http_code = (sent) ? get_http_response_code() : 0;
+
+            bool success = false;
+            if (sent && http_code == 200)
+            {
+                struct data_view body = get_http_response_view();
+                success = (format == FORMAT_JSON) ?
+                    parse_layers_json(body.data, body.size, workspace, append_layer, layers) :
+                    parse_layers_xml(body.data, body.size, workspace, append_layer, layers);
+                if (!success) layers->clear();
+            }
+            // 4xx other than 429 is answer of healthy node, other node gives same
+            bool healthy = success || (sent && http_code >= 300 && http_code < 500 &&
+                http_code != 429);
+            {
+                std::lock_guard<std::mutex> lock(replicas->mutex);
+                report_replica(*replicas, index, healthy, duration_ms);
+            }
+            if (success) return true;
+            if (healthy || !built) return false;
+            previous = index;
+        }
+        return false;
+    }
+
+    std::vector<replica_stats> client::get_replica_stats() const
+    {
+        std::lock_guard<std::mutex> lock(replicas->mutex);
+        std::vector<replica_stats> stats;
+        for (const replica& item : replicas->replicas)
+        {
+            stats.push_back(item.stats);
+            stats.back().ewma_ms = item.ewma_ms;
+            stats.back().error_rate = item.error_rate;
+        }
+        return stats;
+    }
+
+    void print_replica_stats(const std::vector<replica_stats>& stats, FILE* out)
+    {
+        size_t total = 0;
+        for (const replica_stats& item : stats) total += item.reads;
+        fprintf(out, "%-28s %8s %7s %7s %8s %10s %6s %8s\n", "node", "reads", "share",
+            "errors", "ejected", "ewma_ms", "err", "state");
+        for (const replica_stats& item : stats)
+        {
+            fprintf(out, "%-28s %8zu %6.1f%% %7zu %8zu %10.2f %6.2f %8s\n", item.node.c_str(),
+                item.reads, (total) ? 100.0 * item.reads / total : 0.0, item.errors,
+                item.ejections, item.ewma_ms, item.error_rate,
+                (item.ejected) ? "ejected" : "ok");
+        }
+    }
+
+    void print_result(const write_result& result, FILE* out)
+    {
+        fprintf(out, "%-28s %-8s %5s %6s %10s\n", "node", "result", "http", "curl", "ms");
+        for (const struct node_result& node : result.nodes)
+        {
+            const char* status = (!node.done) ? "pending" : (node.success) ? "ok" : "failed";
+            fprintf(out, "%-28s %-8s %5ld %6d %10.2f\n", node.node.c_str(), status,
+                node.http_code, node.curl_code, node.duration_ms);
+        }
+        fprintf(out, "%s: %zu of %zu nodes succeeded in %.2f ms\n",
+            (result.success) ? "success" : "failure", result.succeeded, result.nodes.size(),
+            result.total_ms);
+    }
+
+} // end: namespace cluster
+} // end: namespace geoserver_api
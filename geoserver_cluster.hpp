@@ -0,0 +1,180 @@
+#ifndef GEOSERVER_CLUSTER_HPP
+#define GEOSERVER_CLUSTER_HPP
+
+#include <stdio.h>
+
+#include <string>
+#include <memory>
+#include <vector>
+
+#include "geoserver_curl_wrapper.hpp"
+
+/** Writes to multi-node Geoserver deployment without shared data
+ * directory. Every write is sent to all nodes at once with
+ * "geoserver_async.hpp" engine, so it takes as long as the slowest
+ * node instead of sum of all nodes. Reads go to single replica picked
+ * by latency and error score, slow or failing replicas are ejected for
+ * a while. Credentials and connection options are those of "init()",
+ * which must be called first.
+ */
+
+namespace geoserver_api
+{
+namespace cluster
+{
+    struct node
+    {
+        std::string hostname;
+        int port = 8080;
+    };
+
+    enum write_policy
+    {
+        WRITE_ALL, // every node must succeed, waits for all nodes
+        WRITE_QUORUM // majority of nodes must succeed, returns as soon as it does
+    };
+
+    /**
+     * @brief Outcome of write on single node
+     */
+    struct node_result
+    {
+        std::string node; // {hostname}:{port}
+        bool done = false; // false if quorum was reached before node answered
+        bool success = false; // transfer succeeded and HTTP status code is 2xx
+        long http_code = 0;
+        int curl_code = 0; // CURLcode of transfer
+        double duration_ms = 0; // since write started
+    };
+
+    struct write_result
+    {
+        std::vector<node_result> nodes; // in order of nodes given to "client"
+        size_t succeeded = 0;
+        bool success = false; // policy satisfied
+        double total_ms = 0;
+    };
+
+    enum replica_selection
+    {
+        SELECT_ROUND_ROBIN, // ignores scores, only skips ejected replicas
+        SELECT_POWER_OF_TWO // two random replicas, lower score wins
+    };
+
+    /**
+     * @brief Replica selection of reads. Score of replica is EWMA latency
+     * multiplied by requests in flight and error rate, so busy, slow and
+     * failing replicas get less reads. Errors are transport failures,
+     * 5xx and 429 responses.
+     */
+    struct read_options
+    {
+        replica_selection selection = SELECT_POWER_OF_TWO;
+        double ewma_weight = 0.2; // weight of newest sample, 0..1
+        int read_attempts = 2; // failed read is repeated on other replica
+        int eject_after_failures = 3; // consecutive errors, 0 to disable
+        // Eject replica whose EWMA latency is this many times higher than
+        // that of fastest other replica, 0 to disable
+        double eject_latency_factor = 4.0;
+        int eject_min_samples = 10; // samples needed for latency ejection
+        int eject_ms = 5000; // then replica gets reads again with reset score
+        int max_ejected_percent = 50; // replicas which may be ejected at once
+    };
+
+    /**
+     * @brief Read counters and current score of single replica
+     */
+    struct replica_stats
+    {
+        std::string node; // {hostname}:{port}
+        size_t reads = 0;
+        size_t errors = 0;
+        size_t ejections = 0;
+        double ewma_ms = 0;
+        double error_rate = 0; // EWMA of errors, 0..1
+        bool ejected = false;
+    };
+
+    struct replica_set;
+
+    /**
+     * @brief Client of list of nodes, create it after "init()". Writes hold
+     * async engine with "async::acquire()", last concurrent write stops it and
+     * then waits for all nodes with WRITE_QUORUM. Start engine once with
+     * "async::start()" to avoid both. Reads are blocking and use handle pool.
+     * Client can be used from several threads, copies share replica scores.
+     */
+    class client
+    {
+    public:
+        explicit client(const std::vector<node>& nodes, const write_policy policy=WRITE_ALL);
+
+        size_t size() const { return base_urls.size(); }
+
+        /**
+         * @brief Number of succeeded nodes needed for success of write
+         */
+        size_t required() const;
+
+        /**
+         * @brief "geoserver_api::create_layer()" on every node. 201 on success
+         */
+        write_result create_layer(const char* layer_name, const char* layer_title,
+            const char* postgis_table_name, const char* filter=NULL,
+            const char* workspace="forestAI", const char* datastore="postgis",
+            const bool advertised=true) const;
+
+        /**
+         * @brief "geoserver_api::add_style()" on every node. 200 on success
+         */
+        write_result add_style(const char* layer_name, const char* style_name,
+            const char* layer_workspace="forestAI",
+            const char* style_workspace="forestAI") const;
+
+        /**
+         * @brief "geoserver_api::create_layer_group()" on every node. 201 on success
+         */
+        write_result create_layer_group(const char* layer_group_name,
+            const char* layer_title, const layer_group_builder& layers,
+            const char* workspace="forestAI", const bool advertised=true) const;
+
+        /**
+         * @brief Replace read options, scores are kept
+         */
+        void set_read_options(const read_options& options);
+
+        /**
+         * @brief "geoserver_api::get_layers()" on single replica, see
+         * "read_options". Catalog cache is not used.
+         *
+         * @returns false if all attempts failed. Use "get_http_response_code()"
+         * function to check HTTP status code of last attempt. 200 on success
+         */
+        bool get_layers(const char* workspace, struct layer_list* layers) const;
+
+        /**
+         * @brief Per-replica read counters, in order of nodes given to "client"
+         */
+        std::vector<replica_stats> get_replica_stats() const;
+
+    private:
+        std::vector<std::string> base_urls; // empty string for invalid node
+        std::vector<std::string> names;
+        write_policy policy;
+        std::shared_ptr<replica_set> replicas;
+    };
+
+    /**
+     * @brief Print per-node table of "result"
+     */
+    void print_result(const write_result& result, FILE* out=stdout);
+
+    /**
+     * @brief Print per-replica table of "stats"
+     */
+    void print_replica_stats(const std::vector<replica_stats>& stats, FILE* out=stdout);
+
+} // end: namespace cluster
+} // end: namespace geoserver_api
+
+#endif
@@ -1,70 +1,398 @@
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <ctype.h>
-
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include <zlib.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
 #include "geoserver_curl_wrapper.hpp"
 #include "geoserver_custom_structs.hpp"
+#include "geoserver_internal.hpp"
+#include "geoserver_payload.hpp"
 
 namespace geoserver_api
 {
     // global variables
     static char geoserver_url[128] = {0};
-    static CURL* curl = {NULL};
+    static char* geoserver_userpwd = NULL;
+    static long geoserver_timeout_s = 0;
+    static struct init_options geoserver_options; // only connection options are used
+    static std::string geoserver_ca_file;
+    static std::string geoserver_ca_path;
+    static std::string geoserver_client_cert;
+    static std::string geoserver_client_key;
+
+    // DNS cache and TLS sessions shared between all handles
+    static CURLSH* share = NULL;
+    static std::mutex share_mutexes[CURL_LOCK_DATA_LAST];
+    static CURL* curl = {NULL}; // handle for custom requests
     static struct data_clb_pointer<char> curl_response_body;
 
+    // handle pool
+    static std::vector<curl_pool_entry*> pool_entries;
+    static std::vector<curl_pool_entry*> pool_free_entries;
+    static std::mutex pool_mutex;
+    static std::condition_variable pool_cv;
+
+    // Result of last request made by thread
+    struct thread_response
+    {
+        long http_code = 0;
+        struct data_clb_pointer<char> body;
+        struct metrics::request_timing timing;
+
+        ~thread_response()
+        {
+            if (body.p) free(body.p);
+        }
+    };
+    static thread_local struct thread_response last_response;
+
+    static std::atomic<catalog_format> layers_format{FORMAT_XML};
+
+    void apply_handle_options(CURL* handle, struct data_clb_pointer<char>* body)
+    {
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT, geoserver_timeout_s);
+        curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, geoserver_timeout_s);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1l); // Required for multithreaded use
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, (long)geoserver_options.tcp_keepalive);
+        if (geoserver_options.tcp_keepalive)
+        {
+            curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, geoserver_options.keepalive_idle_s);
+            curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, geoserver_options.keepalive_interval_s);
+        }
+        curl_easy_setopt(handle, CURLOPT_TCP_NODELAY, (long)geoserver_options.tcp_nodelay);
+        switch (geoserver_options.version)
+        {
+            case HTTP_1_1:
+                curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1);
+                break;
+            case HTTP_2:
+                curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2_0);
+                curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1l); // Wait for multiplexing
+                break;
+            case HTTP_2_PRIOR_KNOWLEDGE:
+                curl_easy_setopt(handle, CURLOPT_HTTP_VERSION,
+                    (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+                curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1l);
+                break;
+        }
+        if (geoserver_options.use_https)
+        {
+            if (!geoserver_ca_file.empty())
+                curl_easy_setopt(handle, CURLOPT_CAINFO, geoserver_ca_file.c_str());
+            if (!geoserver_ca_path.empty())
+                curl_easy_setopt(handle, CURLOPT_CAPATH, geoserver_ca_path.c_str());
+            if (!geoserver_client_cert.empty())
+                curl_easy_setopt(handle, CURLOPT_SSLCERT, geoserver_client_cert.c_str());
+            if (!geoserver_client_key.empty())
+                curl_easy_setopt(handle, CURLOPT_SSLKEY, geoserver_client_key.c_str());
+            curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, (long)geoserver_options.verify_peer);
+            curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST,
+                (geoserver_options.verify_host) ? 2l : 0l);
+        }
+        if (share) curl_easy_setopt(handle, CURLOPT_SHARE, share);
+        if (geoserver_options.accept_encoding)
+        {
+            curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, ""); // all built-in encodings
+        }
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, curl_body_callback);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, body);
+        curl_easy_setopt(handle, CURLOPT_USERPWD, geoserver_userpwd);
+    }
+
+    static void share_lock(CURL* handle, curl_lock_data data, curl_lock_access access,
+        void* user_data)
+    {
+        share_mutexes[data].lock();
+    }
+
+    static void share_unlock(CURL* handle, curl_lock_data data, void* user_data)
+    {
+        share_mutexes[data].unlock();
+    }
+
+    /**
+     * Take free handle from pool. Blocks while all handles are in use,
+     * unless "wait" is false, then returns NULL.
+     * Handle is reset, but keeps its connection alive for reuse.
+     */
+    static struct curl_pool_entry* acquire_pool_entry(const bool wait=true)
+    {
+        struct curl_pool_entry* entry = NULL;
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            if (pool_entries.empty())
+            {
+                fprintf(stderr, "acquire_pool_entry(): lib is not initialized\n");
+                return NULL;
+            }
+            if (!wait && pool_free_entries.empty()) return NULL;
+            pool_cv.wait(lock, []{ return !pool_free_entries.empty(); });
+            entry = pool_free_entries.back();
+            pool_free_entries.pop_back();
+        }
+
+        curl_easy_reset(entry->curl); // Keeps live connections
+        apply_handle_options(entry->curl, &entry->response_body);
+        curl_easy_setopt(entry->curl, CURLOPT_PRIVATE, entry);
+        entry->response_body.reset(); // Reset storage
+        return entry;
+    }
+
+    /**
+     * Return handle to pool. Response of the last request is moved
+     * to calling thread storage.
+     */
+    static void release_pool_entry(struct curl_pool_entry* entry)
+    {
+        long http_code = 0;
+        if (curl_easy_getinfo(entry->curl, CURLINFO_RESPONSE_CODE, &http_code) != CURLE_OK)
+            fprintf(stderr, "Getting http code failed\n");
+        last_response.http_code = http_code;
+
+        // Swap buffers instead of copying response body
+        struct data_clb_pointer<char> tmp = last_response.body;
+        last_response.body = entry->response_body;
+        entry->response_body = tmp;
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            pool_free_entries.push_back(entry);
+        }
+        pool_cv.notify_one();
+    }
+
+    static bool append_layer_name(const char* name, void* user_data);
+
+    // Returns pool entry on scope exit
+    struct pooled_handle
+    {
+        struct curl_pool_entry* entry;
+
+        pooled_handle() : entry(acquire_pool_entry()) {}
+        ~pooled_handle()
+        {
+            if (entry) release_pool_entry(entry);
+        }
+        pooled_handle(const pooled_handle&) = delete;
+        pooled_handle& operator=(const pooled_handle&) = delete;
+    };
+
+    /**
+     * Run transfer of pool entry on its multi handle, which keeps
+     * connections of entry like "curl_easy_perform()" would.
+     */
+    static CURLcode perform_entry(struct curl_pool_entry* entry)
+    {
+        if (curl_multi_add_handle(entry->multi, entry->curl) != CURLM_OK)
+        {
+            fprintf(stderr, "curl_multi_add_handle(): failed\n");
+            return CURLE_FAILED_INIT;
+        }
+
+        CURLcode res = CURLE_FAILED_INIT;
+        bool done = false;
+        while (!done)
+        {
+            int running = 0;
+            if (curl_multi_perform(entry->multi, &running) != CURLM_OK)
+            {
+                res = CURLE_FAILED_INIT;
+                break;
+            }
+            int msgs_left = 0;
+            CURLMsg* msg;
+            while ((msg = curl_multi_info_read(entry->multi, &msgs_left)))
+            {
+                if (msg->msg != CURLMSG_DONE) continue;
+                res = msg->data.result;
+                done = true;
+            }
+            if (done) break;
+            curl_multi_poll(entry->multi, NULL, 0, 1000, NULL);
+        }
+        curl_multi_remove_handle(entry->multi, entry->curl);
+        return res;
+    }
+
     bool init(const char* hostname, const int port,
-        const char* username, const char* password, const int timeout_s)
+        const char* username, const char* password, const int timeout_s,
+        const int pool_size)
+    {
+        struct init_options options;
+        options.hostname = hostname;
+        options.port = port;
+        options.username = username;
+        options.password = password;
+        options.timeout_s = timeout_s;
+        options.pool_size = pool_size;
+        return init(options);
+    }
+
+    bool init(const struct init_options& options)
     {
         int j; // for snprintf
+        const char* hostname = options.hostname;
+        const int port = options.port;
+        const char* username = options.username;
+        const char* password = options.password;
+        const int pool_size = options.pool_size;
+
+        if (pool_size < 1)
+        {
+            fprintf(stderr, "init(): pool_size must be positive\n");
+            return false;
+        }
 
         if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
             fprintf(stderr, "curl_global_init() failed\n");
-            return 1;
+            return false;
         }
-
-        curl = curl_easy_init();
-        if (!curl)
+        if (options.version != HTTP_1_1 &&
+            !(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2))
         {
-            fprintf(stderr, "curl_easy_init(): failed\n");
+            fprintf(stderr, "init(): libcurl is built without HTTP/2 support\n");
             return false;
         }
+        geoserver_options = options;
+        if (options.version == HTTP_2_PRIOR_KNOWLEDGE &&
+            curl_version_info(CURLVERSION_NOW)->version_num < 0x080000)
+        {
+            // Reused h2c prior knowledge connection fails with CURLE_HTTP2 there
+            fprintf(stderr, "init(): HTTP/2 prior knowledge is broken in libcurl < 8.0.0, "
+                "using HTTP/2 upgrade instead\n");
+            geoserver_options.version = HTTP_2;
+        }
+        geoserver_options.hostname = NULL;
+        geoserver_options.username = NULL;
+        geoserver_options.password = NULL;
+        geoserver_ca_file = (options.ca_file) ? options.ca_file : "";
+        geoserver_ca_path = (options.ca_path) ? options.ca_path : "";
+        geoserver_client_cert = (options.client_cert) ? options.client_cert : "";
+        geoserver_client_key = (options.client_key) ? options.client_key : "";
+        geoserver_options.ca_file = NULL;
+        geoserver_options.ca_path = NULL;
+        geoserver_options.client_cert = NULL;
+        geoserver_options.client_key = NULL;
+        xmlInitParser(); // Must be done once before parsing from several threads
+
+        // Connection cache is not shared: libcurl does not support sharing
+        // connections between concurrent threads. Pool handles keep own
+        // connections, async handles share connections of multi handle.
+        if (options.share_dns_cache || (options.use_https && options.tls_session_cache))
+        {
+            share = curl_share_init();
+            if (!share)
+            {
+                fprintf(stderr, "curl_share_init(): failed\n");
+                return false;
+            }
+            curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+            curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+            if (options.share_dns_cache)
+            {
+                curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            }
+            if (options.use_https && options.tls_session_cache)
+            {
+                curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            }
+        }
 
         j = snprintf(
             geoserver_url, sizeof(geoserver_url),
-            "http://%s:%d/geoserver/rest", hostname, port
+            "%s://%s:%d/geoserver/rest", (options.use_https) ? "https" : "http",
+            hostname, port
         );
         if (j >= sizeof(geoserver_url) || j < 0)
         {
             fprintf(stderr, "snprintf(): geoserver_url failed\n");
+            cleanup();
             return false;
         }
 
-        // Set global url options
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_s);
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, timeout_s);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_body_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &curl_response_body);
         int len = strlen(username) + strlen(password) + 1 + 1;
-        char user_admin[len] = {0};
-        j = snprintf(user_admin, len, "%s:%s", username, password);
+        geoserver_userpwd = (char*)malloc(len);
+        if (!geoserver_userpwd)
+        {
+            fprintf(stderr, "init(): malloc failed\n");
+            cleanup();
+            return false;
+        }
+        j = snprintf(geoserver_userpwd, len, "%s:%s", username, password);
         if (j >= len || j < 0)
         {
             fprintf(stderr, "snprintf(): user_admin failed '%d'\n", j);
+            cleanup();
+            return false;
+        }
+        geoserver_timeout_s = options.timeout_s;
+
+        curl = curl_easy_init();
+        if (!curl)
+        {
+            fprintf(stderr, "curl_easy_init(): failed\n");
+            cleanup();
             return false;
         }
-        curl_easy_setopt(curl, CURLOPT_USERPWD, user_admin);
+        // Set global url options
+        apply_handle_options(curl, &curl_response_body);
 
+        bool pool_ok = true;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            for (int i = 0; i < pool_size; i++)
+            {
+                struct curl_pool_entry* entry = new curl_pool_entry;
+                entry->curl = curl_easy_init();
+                entry->multi = curl_multi_init();
+                if (!entry->curl || !entry->multi)
+                {
+                    fprintf(stderr, "curl_easy_init(): pool handle failed\n");
+                    if (entry->curl) curl_easy_cleanup(entry->curl);
+                    if (entry->multi) curl_multi_cleanup(entry->multi);
+                    delete entry;
+                    pool_ok = false;
+                    break;
+                }
+                pool_entries.push_back(entry);
+                pool_free_entries.push_back(entry);
+            }
+        }
+        if (!pool_ok)
+        {
+            cleanup();
+            return false;
+        }
 
         return true;
     }
 
     void cleanup()
     {   
+        wait_catalog_revalidation(); // uses pool handles
         if (curl)
         {
             curl_easy_cleanup(curl);
@@ -75,7 +403,85 @@ namespace geoserver_api
             free(curl_response_body.p);
             curl_response_body.p = NULL;
             curl_response_body.size = 0;
-        }        
+            curl_response_body.length = 0;
+        }
+        {
+            // Expects, that no requests are in flight
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            for (struct curl_pool_entry* entry : pool_entries)
+            {
+                curl_easy_cleanup(entry->curl);
+                curl_multi_cleanup(entry->multi);
+                if (entry->response_body.p) free(entry->response_body.p);
+                delete entry;
+            }
+            pool_entries.clear();
+            pool_free_entries.clear();
+        }
+        if (geoserver_userpwd)
+        {
+            free(geoserver_userpwd);
+            geoserver_userpwd = NULL;
+        }
+        if (share)
+        {
+            // All handles using it are cleaned up already
+            curl_share_cleanup(share);
+            share = NULL;
+        }
+        xmlCleanupParser();
+    }
+
+    bool build_warm_up_request(const char* base_url, struct http_request* request)
+    {
+        using payload::lit;
+        payload::build(&request->url, payload::raw{base_url}, lit("/about/version.xml"));
+        request->method = "HEAD";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    int warm_up(const int connections)
+    {
+        int num_handles;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            num_handles = std::min(connections, (int)pool_entries.size());
+        }
+        if (num_handles <= 0) return 0;
+
+        // Handles are taken out of the pool at once, so each gets own connection
+        std::vector<struct curl_pool_entry*> entries;
+        for (int i = 0; i < num_handles; i++)
+        {
+            struct curl_pool_entry* entry = acquire_pool_entry();
+            if (!entry) break;
+            entries.push_back(entry);
+        }
+
+        std::atomic<int> connected{0};
+        auto connect_entry = [&connected](struct curl_pool_entry* entry)
+        {
+            struct http_request request;
+            build_warm_up_request(geoserver_url, &request);
+            struct curl_slist* header = NULL;
+            setup_request(entry->curl, request, &header);
+            if (perform_entry(entry) == CURLE_OK) connected++;
+            if (header) curl_slist_free_all(header);
+        };
+
+        // First handle fills shared DNS cache and TLS session for the others
+        std::vector<std::thread> threads;
+        if (!entries.empty()) connect_entry(entries[0]);
+        for (size_t i = 1; i < entries.size(); i++)
+        {
+            threads.emplace_back(connect_entry, entries[i]);
+        }
+        for (std::thread& thread : threads) thread.join();
+        for (struct curl_pool_entry* entry : entries) release_pool_entry(entry);
+        return connected;
     }
 
     CURL* get_curl_handle()
@@ -83,18 +489,40 @@ namespace geoserver_api
         return curl;
     }
 
+    CURL* acquire_curl_handle()
+    {
+        struct curl_pool_entry* entry = acquire_pool_entry();
+        return (entry) ? entry->curl : NULL;
+    }
+
+    void release_curl_handle(CURL* handle)
+    {
+        struct curl_pool_entry* entry = NULL;
+        if (!handle) return;
+        if (curl_easy_getinfo(handle, CURLINFO_PRIVATE, (char**)&entry) != CURLE_OK || !entry)
+        {
+            fprintf(stderr, "release_curl_handle(): handle is not from pool\n");
+            return;
+        }
+        release_pool_entry(entry);
+    }
+
     long get_http_response_code()
     {
-        long http_code;
-        CURLcode code = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-        if (code != CURLE_OK)
-            fprintf(stderr, "Getting http code failed\n");
-        return http_code;
+        return last_response.http_code;
     }
 
     char* get_http_response_body()
     {
-        return curl_response_body.p;
+        return last_response.body.p;
+    }
+
+    struct data_view get_http_response_view()
+    {
+        struct data_view view;
+        view.data = last_response.body.p;
+        view.size = last_response.body.length;
+        return view;
     }
 
     size_t curl_body_callback(const char* const content, size_t size, size_t nmemb, void* user_data)
@@ -102,323 +530,1017 @@ namespace geoserver_api
         size_t received_size = size * nmemb;
         struct data_clb_pointer<char>* storage = (struct data_clb_pointer<char>*)user_data;
 
-        size_t current_content_len = 0;
-        if (storage->p)
-        {
-            current_content_len = strlen(storage->p);
-        }
-
-        size_t needed_string_len = current_content_len + received_size + 1;
-        if (needed_string_len > storage->size) 
-        {
-            char* tmp = (char*)realloc(storage->p, needed_string_len);
-            if (tmp == NULL) return 0;
-            storage->p = tmp;
-            storage->size = needed_string_len;
-            storage->reset(current_content_len);
-        }
-
         // Append data
-        memcpy(storage->p + current_content_len, content, received_size);
+        if (!storage->append(content, received_size)) return 0;
 
         return received_size;
     }
 
-    bool create_layer(const char* layer_name, const char* layer_title,
-        const char* postgis_table_name, const char* filter,
-        const char* workspace, const char* datastore,
-        const bool advertised)
+    const char* get_base_url()
     {
-        size_t j;
-        char request_url[256] = {0};
-        struct curl_slist* curl_header = NULL;
-
-        curl_response_body.reset(); // Reset storage
-
-        j = snprintf(request_url, sizeof(request_url),
-            "%s/workspaces/%s/datastores/%s/featuretypes", geoserver_url, workspace,
-            datastore
-        );
-        if (j < 0 || j > sizeof(request_url))
-        {
-            fprintf(stderr, "create_layer() requets url too short, need %ld bytes\n", j);
-            return false;
-        }
-        
-        curl_easy_setopt(curl, CURLOPT_URL, request_url);
-
-        // Code data
-        const char* data_template = 
-        "<featureType>"
-            "<name>%s</name>"
-            "<nativeName>%s</nativeName>"
-            "<title>%s</title>"
-            "<srs>EPSG:3059</srs>"
-            "%s" // for filter tag
-            "<advertised>%s</advertised>"
-        "</featureType>";
-
-        char filter_tag[512] = {0};
-        if (filter)
-        {
-            j = snprintf(filter_tag, sizeof(filter_tag),
-            "<cqlFilter>%s</cqlFilter>", filter);
-        }
-        if(j < 0 || j >= sizeof(filter_tag))
-        {
-            fprintf(stderr, "create_layer() filter_tag too short, need %ld bytes\n", j);
-            return false;
-        }
-
-        char data[1024] = {0};
-        j = snprintf(data, sizeof(data), data_template, layer_name,
-            postgis_table_name, layer_title, filter_tag,
-            (advertised) ? "true" : "false"
-        );
+        return geoserver_url;
+    }
 
-        if(j < 0 || j >= sizeof(data))
+    bool make_base_url(const char* hostname, const int port, std::string* url)
+    {
+        char buffer[sizeof(geoserver_url)];
+        int j = snprintf(buffer, sizeof(buffer), "%s://%s:%d/geoserver/rest",
+            (geoserver_options.use_https) ? "https" : "http", hostname, port);
+        if (j >= (int)sizeof(buffer) || j < 0)
         {
-            fprintf(stderr, "create_layer() data too short, need %ld bytes\n", j);
+            fprintf(stderr, "make_base_url(): url too long\n");
             return false;
         }
+        url->assign(buffer, j);
+        return true;
+    }
 
-        const char* header="Content-type: application/xml";
-        curl_header = curl_slist_append(curl_header, header); // Remeber to free
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_header);
-
-        // fprintf(stderr, "SEND: %s\n", data);
-        curl_easy_setopt(curl, CURLOPT_POST, 1l); // Set as POST request
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
-
-        CURLcode res;
-        res = curl_easy_perform(curl);
+    long get_max_host_connections()
+    {
+        return geoserver_options.max_host_connections;
+    }
 
-        if (curl_header)
-        {
-            curl_slist_free_all(curl_header);
-        }
+    void set_last_http_code(long http_code)
+    {
+        last_response.http_code = http_code;
+        last_response.timing = metrics::request_timing();
+    }
 
-        if (res != CURLE_OK)
-        {
-            fprintf(stderr, "curl_easy_perform() failed with code: %d\n", res);
-        }
-        return !res; 
+    struct metrics::request_timing metrics::get_last_request_timing()
+    {
+        return last_response.timing;
     }
 
-    bool add_style(const char* layer_name, const char* style_name,
-        const char* layer_workspace, const char* style_workspace)
+    bool is_catalog_write(const struct http_request& request, CURLcode res,
+        long http_code)
     {
-        size_t j;
-        char request_url[256] = {0};
-        struct curl_slist* curl_header = NULL;
+        if (res != CURLE_OK || strcmp(request.method, "GET") == 0 ||
+            strcmp(request.method, "HEAD") == 0) return false;
+        return http_code >= 200 && http_code < 300;
+    }
 
-        curl_response_body.reset(); // Reset storage
+    // CURL read callback, copies next part of mapped file into send buffer
+    static size_t upload_read_callback(char* buffer, size_t size, size_t nitems,
+        void* user_data)
+    {
+        struct upload_source* source = (struct upload_source*)user_data;
+        size_t length = std::min(size * nitems, source->size - source->offset);
+        memcpy(buffer, source->data + source->offset, length);
+        source->offset += length;
+        return length;
+    }
 
-        j = snprintf(request_url, sizeof(request_url),
-            "%s/layers/%s:%s.xml", geoserver_url,
-            layer_workspace, layer_name
-        );
-        if (j < 0 || j > sizeof(request_url))
+    // CURL seek callback, used when libcurl must send body again
+    static int upload_seek_callback(void* user_data, curl_off_t offset, int origin)
+    {
+        struct upload_source* source = (struct upload_source*)user_data;
+        if (origin != SEEK_SET || offset < 0 || (size_t)offset > source->size)
         {
-            fprintf(stderr, "add_style() requets url too short, need %ld bytes\n", j);
-            return false;
+            return CURL_SEEKFUNC_CANTSEEK;
         }
-        curl_easy_setopt(curl, CURLOPT_URL, request_url);
+        source->offset = offset;
+        return CURL_SEEKFUNC_OK;
+    }
 
-        // Code data
-        const char* data_template = 
-        "<layer>"
-            "<defaultStyle>"
-                "<name>%s:%s</name>"
-            "</defaultStyle>"
-        "</layer>";
-
-        char data[1024] = {0};
-        j = snprintf(data, sizeof(data), data_template,
-            style_workspace, style_name
-        );
+    static int upload_progress_callback_curl(void* user_data, curl_off_t dltotal,
+        curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+    {
+        struct upload_source* source = (struct upload_source*)user_data;
+        return !source->on_progress(ulnow, ultotal, source->user_data); // non 0 aborts
+    }
 
-        if(j < 0 || j >= sizeof(data))
+    // Compress "data" into gzip format, "out" is reused between calls
+    static bool gzip_compress(const char* data, size_t length, std::string* out)
+    {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        // 15 window bits + 16 for gzip header
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK)
         {
-            fprintf(stderr, "add_style() data too short, need %ld bytes\n", j);
+            fprintf(stderr, "gzip_compress(): deflateInit2 failed\n");
             return false;
         }
+        out->resize(deflateBound(&stream, length));
+        stream.next_in = (Bytef*)data;
+        stream.avail_in = length;
+        stream.next_out = (Bytef*)&(*out)[0];
+        stream.avail_out = out->size();
+        int res = deflate(&stream, Z_FINISH);
+        out->resize(stream.total_out);
+        deflateEnd(&stream);
+        return res == Z_STREAM_END;
+    }
 
-        const char* header="Content-type: application/xml";
-        curl_header = curl_slist_append(curl_header, header); // Remeber to free
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_header);
-
-        // curl_easy_setopt(curl, CURLOPT_PUT, 1l); // Set as POST request
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
-
-        CURLcode res;
-        res = curl_easy_perform(curl);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, NULL); // Reset CURLOPT_CUSTOMREQUEST
-
-        if (curl_header)
+    void setup_request(CURL* handle, const struct http_request& request,
+        struct curl_slist** header)
+    {
+        curl_easy_setopt(handle, CURLOPT_URL, request.url.c_str());
+
+        // Compressed body is copied by libcurl, so buffer can be reused
+        static thread_local std::string compressed_body;
+        bool gzip_body = geoserver_options.gzip_request_min_bytes > 0 &&
+            !request.upload && strcmp(request.method, "GET") != 0 &&
+            strcmp(request.method, "HEAD") != 0 &&
+            request.body.size() >= (size_t)geoserver_options.gzip_request_min_bytes &&
+            gzip_compress(request.body.data(), request.body.size(), &compressed_body);
+        if (gzip_body)
         {
-            curl_slist_free_all(curl_header);
+            *header = curl_slist_append(*header, "Content-Encoding: gzip");
         }
 
-        if (res != CURLE_OK)
+        if (request.xml_body)
         {
-            fprintf(stderr, "curl_easy_perform() failed with code: %d\n", res);
+            const char* xml_header="Content-type: application/xml";
+            *header = curl_slist_append(*header, xml_header); // Remeber to free
         }
-        return !res; 
-    }
-
-    char* prepare_layer_group(const char* workspace, int number_layers, ...)
-    {
-        bool success{false};
-        va_list args;
-        va_start(args, number_layers);
-
-        const char layer_template[] =
-            "<published type=\"layer\">"
-                "<name>%s:%s</name>"
-            "</published>";
-                
-        size_t layer_size = (sizeof(layer_template) + 64) * number_layers + 1; // +1 for \0
-        char single_layer[sizeof(layer_template) + 64] = {0}; // for single layer
-
-        char* layers = (char*)malloc(layer_size); // For layer group
-        if (layers == NULL) 
+        for (const std::string& extra_header : request.headers)
         {
-            fprintf(stdout, "prepare_layer_group(): malloc failed\n");
-            goto end;
+            *header = curl_slist_append(*header, extra_header.c_str());
         }
-        
-        memset(layers, 0, layer_size); // Reset to \0 all array
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, *header);
 
-        for(size_t i=0; i < number_layers; i++)
+        if (request.upload)
         {
-            size_t j = snprintf(single_layer, sizeof(single_layer), layer_template,
-                workspace, va_arg(args, char*));
-            if (j < 0 || j >= sizeof(single_layer))
+            struct upload_source* source = request.upload;
+            source->offset = 0;
+            curl_easy_setopt(handle, CURLOPT_UPLOAD, 1l); // PUT
+            curl_easy_setopt(handle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)source->size);
+            curl_easy_setopt(handle, CURLOPT_READFUNCTION, upload_read_callback);
+            curl_easy_setopt(handle, CURLOPT_READDATA, source);
+            curl_easy_setopt(handle, CURLOPT_SEEKFUNCTION, upload_seek_callback);
+            curl_easy_setopt(handle, CURLOPT_SEEKDATA, source);
+            curl_easy_setopt(handle, CURLOPT_UPLOAD_BUFFERSIZE, 512l * 1024); // fewer callbacks
+
+            // Big file does not fit into request timeout, abort stalled upload instead
+            curl_easy_setopt(handle, CURLOPT_TIMEOUT, 0l);
+            curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, 1l);
+            curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, geoserver_timeout_s);
+            if (source->on_progress)
             {
-                fprintf(stderr, "prepare_layer_group() single_layer too short, need %ld bytes\n", j);
-                goto end;
+                curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0l);
+                curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, upload_progress_callback_curl);
+                curl_easy_setopt(handle, CURLOPT_XFERINFODATA, source);
             }
-            strcat(layers, single_layer);
+            return;
         }
-        
-        success = true;
-        end:
-            va_end(args);
-            if (success) return layers;
-            if (layers) free(layers);
-            return NULL;
-    }
-
-    bool create_layer_group(const char* layer_group_name, const char* layer_title,
-        const char* const layer_structure, const char* workspace, const bool advertised)
-    {
-        size_t j;
-        char request_url[256] = {0};
-        struct curl_slist* curl_header = NULL;
 
-        curl_response_body.reset(); // Reset storage
-
-        j = snprintf(request_url, sizeof(request_url),
-            "%s/workspaces/%s/layergroups", geoserver_url,
-            workspace
-        );
-        if (j < 0 || j > sizeof(request_url))
+        if (strcmp(request.method, "GET") == 0)
         {
-            fprintf(stderr, "create_layer_group() requets url too short, need %ld bytes\n", j);
-            return false;
+            curl_easy_setopt(handle, CURLOPT_HTTPGET, 1l);
+            return;
         }
-        curl_easy_setopt(curl, CURLOPT_URL, request_url);
-
-        // Code data
-        const char data_template[] = 
-        "<layerGroup>"
-            "<name>%s</name>"
-            "<title>%s</title>"
-            "<advertised>%s</advertised>"
-            "<workspace>"
-                "<name>%s</name>"
-            "</workspace>"
-            "<publishables>%s</publishables>"
-        "</layerGroup>";
-
-        char data[1024] = {0};
-        j = snprintf(data, sizeof(data), data_template, layer_group_name,
-            layer_title, (advertised) ? "true" : "false", workspace,
-            layer_structure  
-        );
-
-        if(j < 0 || j >= sizeof(data))
+        if (strcmp(request.method, "HEAD") == 0)
         {
-            fprintf(stderr, "create_layer_group() data too short, need %ld bytes\n", j);
-            return false;
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 1l);
+            return;
         }
-
-        const char* header="Content-type: application/xml";
-        curl_header = curl_slist_append(curl_header, header); // Remeber to free
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_header);
-
-        // fprintf(stderr, "SEND: %s\n", data);
-        curl_easy_setopt(curl, CURLOPT_POST, 1l); // Set as POST request
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
-
-        CURLcode res;
-        res = curl_easy_perform(curl);
-
-        if (curl_header)
+        if (strcmp(request.method, "POST") == 0)
         {
-            curl_slist_free_all(curl_header);
+            curl_easy_setopt(handle, CURLOPT_POST, 1l); // Set as POST request
         }
-
-        if (res != CURLE_OK)
+        else
         {
-            fprintf(stderr, "create_layer_group() curl_easy_perform failed: %d\n", res);
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, request.method);
         }
-        return !res; 
+        if (gzip_body)
+        {
+            curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, (long)compressed_body.size());
+            curl_easy_setopt(handle, CURLOPT_COPYPOSTFIELDS, compressed_body.data());
+            return;
+        }
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, (long)request.body.size());
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request.body.c_str());
     }
 
-    bool get_layers(const char* workspace, int* num_layers, char*** layer_names)
+    // Optional behaviour of "perform_request()"
+    struct request_hooks
     {
-        bool status {false};
-        // Check inputs
-        if (*layer_names != NULL)
+        bool hedge = false; // hedge slow request, response must be buffered
+        // Called before request is repeated, returns false to give up
+        bool (*before_retry)(void* data) = NULL;
+        void* data = NULL;
+    };
+
+    // Returns hedge entry to pool, its response is not the last one
+    static void discard_pool_entry(struct curl_pool_entry* entry)
+    {
+        entry->response_body.reset();
         {
-            fprintf(stderr, "get_layers() layer_names parameter not NULL");
-            return false;
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            pool_free_entries.push_back(entry);
         }
-        size_t j;
-        char request_url[256] = {0};
-        struct curl_slist* curl_header = NULL;
-
-        curl_response_body.reset(); // Reset storage
+        pool_cv.notify_one();
+    }
 
-        j = snprintf(request_url, sizeof(request_url),
-            "%s/layers.xml", geoserver_url
-        );
-        if (j < 0 || j > sizeof(request_url))
+    /**
+     * Run request on "handle" and, if no response arrives within hedge
+     * delay, send the same request on free pool handle. Both transfers
+     * run on multi handle of "handle" in calling thread. First usable
+     * response wins, the other transfer is cancelled. If hedge wins,
+     * transfers are swapped, so "handle" always holds the winner.
+     */
+    static CURLcode perform_hedged(struct curl_pool_entry* handle,
+        const struct http_request& request, const metrics::operation op)
+    {
+        CURLM* multi = handle->multi;
+        if (curl_multi_add_handle(multi, handle->curl) != CURLM_OK)
         {
-            fprintf(stderr, "get_layers() requets url too short, need %ld bytes\n", j);
-            return false;
+            fprintf(stderr, "curl_multi_add_handle(): failed\n");
+            return CURLE_FAILED_INIT;
         }
-
-        CURLcode res;
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
-        res = curl_easy_setopt(curl, CURLOPT_URL, request_url);
-        res = curl_easy_setopt(curl, CURLOPT_POST, 0l); // Set as GET request
-        // res = curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-
-        res = curl_easy_perform(curl);
+        const std::chrono::steady_clock::time_point hedge_at =
+            std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(hedge_delay_ms(get_hedge_policy(), op));
+        bool armed = true; // hedge is neither sent nor skipped yet
+        struct curl_pool_entry* hedge = NULL;
+        struct curl_slist* hedge_header = NULL;
+        struct limiter_slot hedge_slot; // hedge is one more request in flight
+
+        CURLcode res = CURLE_FAILED_INIT;
+        CURL* winner = NULL;
+        while (!winner)
+        {
+            int running = 0;
+            if (curl_multi_perform(multi, &running) != CURLM_OK) break;
+            int msgs_left = 0;
+            CURLMsg* msg;
+            while (!winner && (msg = curl_multi_info_read(multi, &msgs_left)))
+            {
+                if (msg->msg != CURLMSG_DONE) continue;
+                if (msg->easy_handle == handle->curl)
+                {
+                    res = msg->data.result;
+                    winner = handle->curl;
+                    continue;
+                }
+                // Failed hedge leaves primary running
+                long http_code = 0;
+                double latency_s = 0;
+                curl_easy_getinfo(hedge->curl, CURLINFO_RESPONSE_CODE, &http_code);
+                curl_easy_getinfo(hedge->curl, CURLINFO_TOTAL_TIME, &latency_s);
+                release_limiter_slot(&hedge_slot, msg->data.result, http_code, latency_s);
+                if (msg->data.result == CURLE_OK && !is_retryable_status(http_code))
+                {
+                    res = CURLE_OK;
+                    winner = hedge->curl;
+                }
+            }
+            if (winner) break;
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (armed && now >= hedge_at)
+            {
+                armed = false;
+                // Never wait for handle or limiter slot, hedge is pointless
+                // if pool is busy or server is at concurrency limit
+                hedge = acquire_pool_entry(false);
+                if (hedge && !try_acquire_limiter_slot(&hedge_slot))
+                {
+                    discard_pool_entry(hedge);
+                    hedge = NULL;
+                }
+                if (hedge)
+                {
+                    setup_request(hedge->curl, request, &hedge_header);
+                    if (curl_multi_add_handle(multi, hedge->curl) == CURLM_OK)
+                    {
+                        record_hedge(op, false);
+                    }
+                }
+            }
+            int timeout_ms = 1000;
+            if (armed)
+            {
+                long long until_hedge_ms = std::chrono::duration_cast<
+                    std::chrono::milliseconds>(hedge_at - now).count();
+                timeout_ms = (int)std::max(0ll, std::min(until_hedge_ms + 1, 1000ll));
+            }
+            curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+        }
+        // Removing unfinished transfer cancels it
+        curl_multi_remove_handle(multi, handle->curl);
+        if (hedge)
+        {
+            curl_multi_remove_handle(multi, hedge->curl);
+            if (hedge_header) curl_slist_free_all(hedge_header);
+            // Cancelled hedge gives no latency sample
+            release_limiter_slot(&hedge_slot, CURLE_ABORTED_BY_CALLBACK, 0, 0);
+        }
+
+        if (hedge && winner == hedge->curl)
+        {
+            record_hedge(op, true);
+            std::swap(handle->curl, hedge->curl);
+            std::swap(handle->response_body, hedge->response_body);
+            for (struct curl_pool_entry* entry : {handle, hedge})
+            {
+                curl_easy_setopt(entry->curl, CURLOPT_WRITEDATA, &entry->response_body);
+                curl_easy_setopt(entry->curl, CURLOPT_PRIVATE, entry);
+            }
+        }
+        // Not "release_pool_entry()", loser must not replace last response
+        if (hedge) discard_pool_entry(hedge);
+        return res;
+    }
+
+    /**
+     * Execute request on pooled handle. Response body stays in
+     * "handle->response_body" until handle is released. Failed
+     * idempotent requests are repeated according to retry policy.
+     */
+    static CURLcode perform_request(struct curl_pool_entry* handle,
+        const struct http_request& request, const metrics::operation op,
+        const struct request_hooks* hooks=NULL)
+    {
+        const struct retry_policy policy = get_retry_policy();
+        CURLcode res = CURLE_OK;
+        long http_code = 0;
+        for (int attempt = 1; ; attempt++)
+        {
+            // Slot is not held while waiting for retry
+            struct limiter_slot slot;
+            acquire_limiter_slot(&slot);
+
+            // Hedge may have swapped handle, so setup on every attempt
+            struct curl_slist* curl_header = NULL;
+            setup_request(handle->curl, request, &curl_header);
+
+            res = (hooks && hooks->hedge) ? perform_hedged(handle, request, op) :
+                perform_entry(handle);
+
+            if (curl_header)
+            {
+                curl_slist_free_all(curl_header);
+            }
+
+            http_code = 0;
+            curl_easy_getinfo(handle->curl, CURLINFO_RESPONSE_CODE, &http_code);
+            record_request(op, handle->curl, res, http_code, &last_response.timing);
+            release_limiter_slot(&slot, res, http_code, last_response.timing.total_s);
+
+            if (attempt >= policy.max_attempts || !is_retryable(request, res, http_code)) break;
+            if (hooks && hooks->before_retry && !hooks->before_retry(hooks->data)) break;
+
+            curl_off_t retry_after_s = 0;
+            curl_easy_getinfo(handle->curl, CURLINFO_RETRY_AFTER, &retry_after_s);
+            record_retry(op);
+            std::this_thread::sleep_for(std::chrono::milliseconds(
+                retry_delay_ms(policy, attempt, retry_after_s)));
+            handle->response_body.reset();
+        }
+        if (is_catalog_write(request, res, http_code)) invalidate_catalog_cache();
+        return res;
+    }
+
+    bool build_create_layer_request(const char* base_url, const char* layer_name,
+        const char* layer_title, const char* postgis_table_name, const char* filter,
+        const char* workspace, const char* datastore, const bool advertised,
+        struct http_request* request)
+    {
+        using payload::lit;
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/workspaces/"), payload::url{workspace},
+            lit("/datastores/"), payload::url{datastore},
+            lit("/featuretypes")
+        );
+
+        // Code data
+        const char* advertised_text = (advertised) ? "true" : "false";
+        if (filter)
+        {
+            payload::build(&request->body,
+            lit("<featureType>"
+                    "<name>"), payload::xml{layer_name}, lit("</name>"
+                    "<nativeName>"), payload::xml{postgis_table_name}, lit("</nativeName>"
+                    "<title>"), payload::xml{layer_title}, lit("</title>"
+                    "<srs>EPSG:3059</srs>"
+                    "<cqlFilter>"), payload::xml{filter}, lit("</cqlFilter>"
+                    "<advertised>"), payload::raw{advertised_text}, lit("</advertised>"
+                "</featureType>")
+            );
+        }
+        else
+        {
+            payload::build(&request->body,
+            lit("<featureType>"
+                    "<name>"), payload::xml{layer_name}, lit("</name>"
+                    "<nativeName>"), payload::xml{postgis_table_name}, lit("</nativeName>"
+                    "<title>"), payload::xml{layer_title}, lit("</title>"
+                    "<srs>EPSG:3059</srs>"
+                    "<advertised>"), payload::raw{advertised_text}, lit("</advertised>"
+                "</featureType>")
+            );
+        }
+
+        request->method = "POST";
+        request->xml_body = true;
+        request->headers.clear();
+        return true;
+    }
+
+    bool create_layer(const char* layer_name, const char* layer_title,
+        const char* postgis_table_name, const char* filter,
+        const char* workspace, const char* datastore,
+        const bool advertised)
+    {
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_create_layer_request(geoserver_url, layer_name, layer_title,
+            postgis_table_name, filter, workspace, datastore, advertised, &request))
+        {
+            return false;
+        }
+
+        pooled_handle handle;
+        if (!handle.entry) return false;
+
+        CURLcode res = perform_request(handle.entry, request, metrics::OP_CREATE_LAYER);
+        if (res != CURLE_OK)
+        {
+            fprintf(stderr, "curl_easy_perform() failed with code: %d\n", res);
+        }
+        return !res; 
+    }
+
+    bool build_add_style_request(const char* base_url, const char* layer_name,
+        const char* style_name, const char* layer_workspace, const char* style_workspace,
+        struct http_request* request)
+    {
+        using payload::lit;
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/layers/"), payload::url{layer_workspace},
+            lit(":"), payload::url{layer_name}, lit(".xml")
+        );
+
+        // Code data
+        payload::build(&request->body,
+        lit("<layer>"
+                "<defaultStyle>"
+                    "<name>"), payload::xml{style_workspace}, lit(":"),
+                        payload::xml{style_name}, lit("</name>"
+                "</defaultStyle>"
+            "</layer>")
+        );
+
+        request->method = "PUT";
+        request->xml_body = true;
+        request->headers.clear();
+        return true;
+    }
+
+    bool add_style(const char* layer_name, const char* style_name,
+        const char* layer_workspace, const char* style_workspace)
+    {
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_add_style_request(geoserver_url, layer_name, style_name,
+            layer_workspace, style_workspace, &request))
+        {
+            return false;
+        }
+
+        pooled_handle handle;
+        if (!handle.entry) return false;
+
+        CURLcode res = perform_request(handle.entry, request, metrics::OP_ADD_STYLE);
+        if (res != CURLE_OK)
+        {
+            fprintf(stderr, "curl_easy_perform() failed with code: %d\n", res);
+        }
+        return !res; 
+    }
+
+    const std::string layer_group_builder::empty_styles;
+
+    bool layer_group_builder::add(const char* workspace, const char* layer_name,
+        const char* style_name, const char* style_workspace)
+    {
+        using payload::lit;
+
+        if (!workspace || !layer_name || !workspace[0] || !layer_name[0])
+        {
+            fprintf(stderr, "layer_group_builder::add() workspace and layer name must be set\n");
+            return false;
+        }
+
+        payload::append(&published_xml,
+            lit("<published type=\"layer\">"
+                    "<name>"), payload::xml{workspace}, lit(":"), payload::xml{layer_name},
+                lit("</name>"
+                "</published>")
+        );
+
+        // Styles are matched with layers by position
+        if (!style_name || !style_name[0])
+        {
+            payload::append(&styles_xml, lit("<style/>"));
+        }
+        else
+        {
+            has_styles = true;
+            bool global = !style_workspace || !style_workspace[0];
+            payload::append(&styles_xml,
+                lit("<style>"
+                    "<name>"), payload::xml{(global) ? "" : style_workspace},
+                    payload::raw{(global) ? "" : ":"}, payload::xml{style_name}, lit("</name>"
+                "</style>")
+            );
+        }
+        num_layers++;
+        return true;
+    }
+
+    void layer_group_builder::clear()
+    {
+        published_xml.clear();
+        styles_xml.clear();
+        num_layers = 0;
+        has_styles = false;
+    }
+
+    char* prepare_layer_group(const char* workspace, int number_layers, ...)
+    {
+        va_list args;
+        va_start(args, number_layers);
+
+        layer_group_builder layers;
+        bool success = true;
+        for (int i = 0; i < number_layers && success; i++)
+        {
+            success = layers.add(workspace, va_arg(args, const char*));
+        }
+        va_end(args);
+        if (!success) return NULL;
+
+        char* structure = strdup(layers.publishables().c_str());
+        if (!structure) fprintf(stderr, "prepare_layer_group(): malloc failed\n");
+        return structure;
+    }
+
+    bool build_create_layer_group_request(const char* base_url,
+        const char* layer_group_name, const char* layer_title,
+        const char* const layer_structure, const char* styles, const char* workspace,
+        const bool advertised, struct http_request* request)
+    {
+        using payload::lit;
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/workspaces/"), payload::url{workspace}, lit("/layergroups")
+        );
+
+        // Code data, "layer_structure" and "styles" are already XML
+        bool with_styles = styles && styles[0];
+        payload::build(&request->body,
+        lit("<layerGroup>"
+                "<name>"), payload::xml{layer_group_name}, lit("</name>"
+                "<title>"), payload::xml{layer_title}, lit("</title>"
+                "<advertised>"), payload::raw{(advertised) ? "true" : "false"}, lit("</advertised>"
+                "<workspace>"
+                    "<name>"), payload::xml{workspace}, lit("</name>"
+                "</workspace>"
+                "<publishables>"), payload::raw{layer_structure}, lit("</publishables>"),
+                payload::raw{(with_styles) ? "<styles>" : NULL}, payload::raw{styles},
+                payload::raw{(with_styles) ? "</styles>" : NULL},
+            lit("</layerGroup>")
+        );
+
+        request->method = "POST";
+        request->xml_body = true;
+        request->headers.clear();
+        return true;
+    }
+
+    static bool send_create_layer_group(const char* layer_group_name,
+        const char* layer_title, const char* const layer_structure, const char* styles,
+        const char* workspace, const bool advertised)
+    {
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_create_layer_group_request(geoserver_url, layer_group_name,
+            layer_title, layer_structure, styles, workspace, advertised, &request))
+        {
+            return false;
+        }
+
+        pooled_handle handle;
+        if (!handle.entry) return false;
+
+        CURLcode res = perform_request(handle.entry, request, metrics::OP_CREATE_LAYER_GROUP);
+        if (res != CURLE_OK)
+        {
+            fprintf(stderr, "create_layer_group() curl_easy_perform failed: %d\n", res);
+        }
+        return !res; 
+    }
+
+    bool create_layer_group(const char* layer_group_name, const char* layer_title,
+        const char* const layer_structure, const char* workspace, const bool advertised)
+    {
+        return send_create_layer_group(layer_group_name, layer_title, layer_structure,
+            NULL, workspace, advertised);
+    }
+
+    bool create_layer_group(const char* layer_group_name, const char* layer_title,
+        const layer_group_builder& layers, const char* workspace, const bool advertised)
+    {
+        if (layers.size() == 0)
+        {
+            fprintf(stderr, "create_layer_group() layer group has no layers\n");
+            return false;
+        }
+        return send_create_layer_group(layer_group_name, layer_title,
+            layers.publishables().c_str(), layers.styles().c_str(), workspace, advertised);
+    }
+
+    bool build_update_layer_group_request(const char* base_url,
+        const char* layer_group_name, const char* layer_title,
+        const char* const layer_structure, const char* styles, const char* workspace,
+        const bool advertised, struct http_request* request)
+    {
+        using payload::lit;
+
+        // Same document as creation, sent to layer group resource
+        if (!build_create_layer_group_request(base_url, layer_group_name, layer_title,
+            layer_structure, styles, workspace, advertised, request))
+        {
+            return false;
+        }
+        payload::append(&request->url, lit("/"), payload::url{layer_group_name}, lit(".xml"));
+        request->method = "PUT";
+        return true;
+    }
+
+    bool build_delete_layer_request(const char* base_url, const char* layer_name,
+        const char* workspace, const char* datastore, struct http_request* request)
+    {
+        using payload::lit;
+
+        // Feature type is removed with its layer, so name can be reused
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/workspaces/"), payload::url{workspace},
+            lit("/datastores/"), payload::url{datastore},
+            lit("/featuretypes/"), payload::url{layer_name}, lit("?recurse=true")
+        );
+
+        request->method = "DELETE";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    bool build_delete_layer_group_request(const char* base_url,
+        const char* layer_group_name, const char* workspace, struct http_request* request)
+    {
+        using payload::lit;
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/workspaces/"), payload::url{workspace},
+            lit("/layergroups/"), payload::url{layer_group_name}
+        );
+
+        request->method = "DELETE";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    bool build_get_layer_groups_request(const char* base_url, const char* workspace,
+        struct http_request* request)
+    {
+        using payload::lit;
+
+        if (!workspace || !workspace[0])
+        {
+            fprintf(stderr, "get_layer_groups() workspace parameter is NULL or empty\n");
+            return false;
+        }
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/workspaces/"), payload::url{workspace}, lit("/layergroups.xml")
+        );
+
+        request->method = "GET";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    bool build_get_layer_request(const char* base_url, const char* layer_name,
+        const char* workspace, struct http_request* request)
+    {
+        using payload::lit;
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/layers/"), payload::url{workspace},
+            lit(":"), payload::url{layer_name}, lit(".xml")
+        );
+
+        request->method = "GET";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    bool build_get_layer_group_request(const char* base_url, const char* layer_group_name,
+        const char* workspace, struct http_request* request)
+    {
+        using payload::lit;
+
+        payload::build(&request->url, payload::raw{base_url},
+            lit("/workspaces/"), payload::url{workspace},
+            lit("/layergroups/"), payload::url{layer_group_name}, lit(".xml")
+        );
+
+        request->method = "GET";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    bool send_request(const char* function_name, const struct http_request& request,
+        const metrics::operation op)
+    {
+        pooled_handle handle;
+        if (!handle.entry) return false;
+
+        CURLcode res = perform_request(handle.entry, request, op);
+        if (res != CURLE_OK)
+        {
+            fprintf(stderr, "%s curl_easy_perform failed: %d\n", function_name, res);
+        }
+        return !res;
+    }
+
+    bool update_layer_group(const char* layer_group_name, const char* layer_title,
+        const layer_group_builder& layers, const char* workspace, const bool advertised)
+    {
+        if (layers.size() == 0)
+        {
+            fprintf(stderr, "update_layer_group() layer group has no layers\n");
+            return false;
+        }
+
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_update_layer_group_request(geoserver_url, layer_group_name, layer_title,
+            layers.publishables().c_str(), layers.styles().c_str(), workspace, advertised,
+            &request))
+        {
+            return false;
+        }
+        return send_request("update_layer_group()", request, metrics::OP_UPDATE_LAYER_GROUP);
+    }
+
+    bool delete_layer(const char* layer_name, const char* workspace, const char* datastore)
+    {
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_delete_layer_request(geoserver_url, layer_name, workspace, datastore,
+            &request))
+        {
+            return false;
+        }
+        return send_request("delete_layer()", request, metrics::OP_DELETE);
+    }
+
+    bool delete_layer_group(const char* layer_group_name, const char* workspace)
+    {
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_delete_layer_group_request(geoserver_url, layer_group_name, workspace,
+            &request))
+        {
+            return false;
+        }
+        return send_request("delete_layer_group()", request, metrics::OP_DELETE);
+    }
+
+    bool get_layer_groups(const char* workspace, struct layer_list* groups)
+    {
+        groups->clear();
+        static thread_local struct http_request request; // Reuse buffers
+        if (!build_get_layer_groups_request(geoserver_url, workspace, &request) ||
+            !send_request("get_layer_groups()", request, metrics::OP_GET_DETAILS))
+        {
+            return false;
+        }
+        if (last_response.http_code != 200) return false;
+
+        // Same layout as layer list, names are returned as {workspace}:{name}
+        if (parse_layers_xml(last_response.body.p, last_response.body.length, workspace,
+            append_layer_name, groups))
+        {
+            return true;
+        }
+        groups->clear();
+        return false;
+    }
+
+    /**
+     * Map "file_path" and PUT it to
+     * "{base_url}/workspaces/{workspace}/{store_type}/{store}/{file_name}".
+     */
+    static bool upload_file(const char* function_name, const char* file_path,
+        const char* store_type, const char* store, const char* file_name,
+        const char* content_type, const char* workspace,
+        upload_progress_callback on_progress, void* user_data, struct upload_stats* stats)
+    {
+        using payload::lit;
+
+        if (!file_path || !store || !workspace)
+        {
+            fprintf(stderr, "%s() file path, store and workspace must be set\n", function_name);
+            return false;
+        }
+
+        struct http_request request;
+        request.method = "PUT";
+        payload::build(&request.url, payload::raw{geoserver_url},
+            lit("/workspaces/"), payload::url{workspace},
+            lit("/"), payload::raw{store_type}, lit("/"), payload::url{store},
+            lit("/"), payload::raw{file_name}
+        );
+        request.headers.push_back(std::string("Content-type: ") + content_type);
+
+        int fd = open(file_path, O_RDONLY);
+        if (fd < 0)
+        {
+            fprintf(stderr, "%s() can not open %s: %s\n", function_name, file_path,
+                strerror(errno));
+            return false;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0)
+        {
+            fprintf(stderr, "%s() can not stat %s: %s\n", function_name, file_path,
+                strerror(errno));
+            close(fd);
+            return false;
+        }
+
+        struct upload_source source;
+        source.size = file_stat.st_size;
+        source.on_progress = on_progress;
+        source.user_data = user_data;
+        void* mapping = NULL;
+        if (source.size > 0)
+        {
+            mapping = mmap(NULL, source.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                fprintf(stderr, "%s() mmap of %s failed: %s\n", function_name, file_path,
+                    strerror(errno));
+                close(fd);
+                return false;
+            }
+            madvise(mapping, source.size, MADV_SEQUENTIAL); // Aggressive read-ahead
+            source.data = (const char*)mapping;
+        }
+        close(fd); // Mapping stays valid
+        request.upload = &source;
+
+        CURLcode res;
+        {
+            pooled_handle handle;
+            if (!handle.entry)
+            {
+                if (mapping) munmap(mapping, source.size);
+                return false;
+            }
+            res = perform_request(handle.entry, request, metrics::OP_UPLOAD_FILE);
+        }
+        if (mapping) munmap(mapping, source.size);
 
         if (res != CURLE_OK)
         {
-            fprintf(stderr, "get_layers() curl_easy_perform failed: %d\n", res);
-            return !res;
+            fprintf(stderr, "%s() curl_easy_perform failed: %d\n", function_name, res);
+        }
+        if (stats)
+        {
+            const struct metrics::request_timing& timing = last_response.timing;
+            stats->bytes = timing.bytes_up;
+            stats->seconds = timing.total_s;
+            stats->bytes_per_s = (timing.total_s > 0) ? timing.bytes_up / timing.total_s : 0;
         }
+        return !res;
+    }
+
+    bool upload_geotiff(const char* file_path, const char* coverage_store,
+        const char* workspace, upload_progress_callback on_progress, void* user_data,
+        struct upload_stats* stats)
+    {
+        return upload_file("upload_geotiff", file_path, "coveragestores", coverage_store,
+            "file.geotiff", "image/tiff", workspace, on_progress, user_data, stats);
+    }
+
+    bool upload_shapefile(const char* zip_path, const char* datastore,
+        const char* workspace, upload_progress_callback on_progress, void* user_data,
+        struct upload_stats* stats)
+    {
+        return upload_file("upload_shapefile", zip_path, "datastores", datastore,
+            "file.shp", "application/zip", workspace, on_progress, user_data, stats);
+    }
+
+    void set_catalog_format(const catalog_format format)
+    {
+        layers_format = format;
+    }
+
+    catalog_format get_catalog_format()
+    {
+        return layers_format;
+    }
+
+    bool build_get_layers_request(const char* base_url, const char* workspace,
+        const catalog_format format, struct http_request* request)
+    {
+        using payload::lit;
+        const char* extension = (format == FORMAT_JSON) ? "json" : "xml";
+
+        if (workspace)
+        {
+            // Let Geoserver filter layers of workspace
+            payload::build(&request->url, payload::raw{base_url},
+                lit("/workspaces/"), payload::url{workspace},
+                lit("/layers."), payload::raw{extension}
+            );
+        }
+        else
+        {
+            payload::build(&request->url, payload::raw{base_url},
+                lit("/layers."), payload::raw{extension}
+            );
+        }
+
+        request->method = "GET";
+        request->body.clear();
+        request->xml_body = false;
+        request->headers.clear();
+        return true;
+    }
+
+    /**
+     * Copy layer name without whitespace (from pretty printed XML) to "out",
+     * which must have space for NAME_MAX characters.
+     */
+    static bool filter_layer_name(const char* in, size_t len, char* out)
+    {
+        size_t i = 0;
+        for (const char* end = in + len; in < end; in++)
+        {
+            if (isspace((unsigned char)*in)) continue;
+            if (i + 1 >= NAME_MAX) return false;
+            out[i++] = *in;
+        }
+        out[i] = 0;
+        return true;
+    }
+
+    bool emit_layer_name(const char* raw_name, size_t len, const char* workspace,
+        layer_name_callback on_layer, void* user_data)
+    {
+        char name[NAME_MAX] = {0};
+        if (!filter_layer_name(raw_name, len, name))
+        {
+            fprintf(stderr, "get_layers(): filter_layer_name failed\n");
+            return false;
+        }
+
+        if (workspace)
+        {
+            const char* colon = strchr(name, ':');
+            size_t workspace_len = strlen(workspace);
+            if (!colon)
+            {
+                // Workspace endpoint may return names without workspace
+                size_t name_len = strlen(name);
+                if (workspace_len + 1 + name_len + 1 > NAME_MAX)
+                {
+                    fprintf(stderr, "get_layers(): layer name too long\n");
+                    return false;
+                }
+                memmove(name + workspace_len + 1, name, name_len + 1);
+                memcpy(name, workspace, workspace_len);
+                name[workspace_len] = ':';
+            }
+            else if ((size_t)(colon - name) != workspace_len ||
+                strncmp(workspace, name, workspace_len) != 0)
+            {
+                return true; // Layer of other workspace, skip it
+            }
+        }
+        return on_layer(name, user_data);
+    }
+
+    bool parse_layers_xml(const char* data, size_t len, const char* workspace,
+        layer_name_callback on_layer, void* user_data)
+    {
+        bool status {false};
 
         // Parse XML response
-        xmlDocPtr doc = xmlReadMemory(curl_response_body.p, strlen(curl_response_body.p),
-            NULL, NULL, 0);
+        xmlDocPtr doc = xmlReadMemory(data, len, NULL, NULL, 0);
 
         if (doc == NULL)
         {
@@ -434,33 +1556,12 @@ namespace geoserver_api
             return false;
         }  
 
-        *num_layers = 0;
-
-        // Lambda for filtering content
-        auto filter_content_lambde = [](const char* in, char* out) -> bool
-        {
-            int i = 0;
-            while(*in != 0)
-            {
-                if (isalnum(*in)|| (*in)==':')
-                {
-                    i++;
-                    if (i >= NAME_MAX) return false;
-                    *out = *in;
-                    out++;
-                }
-                in++;
-            }
-            return true;
-        };
-
         for(xmlNodePtr node = root->children; node; node = node->next)
         {
             if(node->type == XML_ELEMENT_NODE)
             {
                 char* content = (char*)xmlNodeGetContent(node);
                 // char* name = (char*)node->name;
-                char filter_content[NAME_MAX] = {0};
 
                 if(!content)
                 {
@@ -468,70 +1569,443 @@ namespace geoserver_api
                     goto cleanup;
                 }
 
-                bool filt = filter_content_lambde(content, filter_content);
+                bool emitted = emit_layer_name(content, strlen(content), workspace,
+                    on_layer, user_data);
                 xmlFree(content);  // Important to free
-                if(!filt)
-                {
-                    fprintf(stderr, "get_layers(): filter_content_lambde failed\n");
-                    goto cleanup;
-                }
-
-                if (workspace)
-                {
-                    if (strncmp(workspace, filter_content, strlen(workspace)) != 0)
-                    {
-                        continue;
-                    }
-                }
-
-                // For first layer dimension
-                char** tmp_1_dim = (char**)realloc(*layer_names, sizeof(char*) * ((*num_layers)+1));
-                if (!tmp_1_dim)
-                {
-                    // free all resource
-                    fprintf(stderr, "Failed realloc\n");
-                    goto cleanup;
-                }
-                *layer_names = tmp_1_dim;
-                
-                // For second layer dimension
-                char* tmp_2_dim = (char*)malloc(strlen(filter_content)+1);
-                if(!tmp_2_dim)
-                {
-                    // free all resource
-                    fprintf(stderr, "Failed malloc\n");
-                    goto cleanup;
-                }
-                memset(tmp_2_dim, 0 , strlen(filter_content)+1);
-                strcpy(tmp_2_dim, filter_content);
-                (*layer_names)[*num_layers] = tmp_2_dim;
-                (*num_layers)++;
+                if (!emitted) goto cleanup;
             }
         }
         status = true;
-        if (doc) xmlFreeDoc(doc);
-        xmlCleanupParser();
 
-        return status;
-        
         cleanup:
             if (doc) xmlFreeDoc(doc);
-            xmlCleanupParser();
+            return status;
+    }
+
+    // State of streaming "layers.xml" parser
+    struct layer_stream_parser
+    {
+        xmlParserCtxtPtr ctxt = NULL;
+        int depth = 0; // 1 - <layers>, 2 - <layer>, 3 - <name>
+        bool in_name = false;
+        char name[NAME_MAX] = {0};
+        size_t name_len = 0;
+        size_t num_names = 0; // names passed to "on_layer"
+        bool failed = false;
+
+        const char* workspace = NULL;
+        layer_name_callback on_layer = NULL;
+        void* user_data = NULL;
+
+        CURL* curl = NULL;
+        int http_ok = -1; // unknown until first chunk
+        struct data_clb_pointer<char>* error_body = NULL;
+    };
+
+    static void stream_start_element(void* ctx, const xmlChar* localname,
+        const xmlChar* prefix, const xmlChar* URI, int nb_namespaces,
+        const xmlChar** namespaces, int nb_attributes, int nb_defaulted,
+        const xmlChar** attributes)
+    {
+        struct layer_stream_parser* parser = (struct layer_stream_parser*)
+            ((xmlParserCtxtPtr)ctx)->_private;
+        parser->depth++;
+        if (parser->depth == 3 && !prefix && strcmp((const char*)localname, "name") == 0)
+        {
+            parser->in_name = true;
+            parser->name_len = 0;
+        }
+    }
+
+    static void stream_end_element(void* ctx, const xmlChar* localname,
+        const xmlChar* prefix, const xmlChar* URI)
+    {
+        xmlParserCtxtPtr ctxt = (xmlParserCtxtPtr)ctx;
+        struct layer_stream_parser* parser = (struct layer_stream_parser*)ctxt->_private;
+        parser->depth--;
+        if (!parser->in_name) return;
+        parser->in_name = false;
+
+        // Layer name is complete, emit it
+        parser->num_names++;
+        if (!emit_layer_name(parser->name, parser->name_len, parser->workspace,
+            parser->on_layer, parser->user_data))
+        {
+            parser->failed = true;
+            xmlStopParser(ctxt);
+        }
+    }
+
+    static void stream_characters(void* ctx, const xmlChar* ch, int len)
+    {
+        xmlParserCtxtPtr ctxt = (xmlParserCtxtPtr)ctx;
+        struct layer_stream_parser* parser = (struct layer_stream_parser*)ctxt->_private;
+        if (!parser->in_name) return;
+        if (parser->name_len + len >= NAME_MAX)
+        {
+            fprintf(stderr, "get_layers_stream(): layer name too long\n");
+            parser->failed = true;
+            xmlStopParser(ctxt);
+            return;
+        }
+        memcpy(parser->name + parser->name_len, ch, len);
+        parser->name_len += len;
+    }
+
+    // CURL write callback, which feeds response into push parser
+    static size_t layer_stream_callback(const char* const content, size_t size,
+        size_t nmemb, void* user_data)
+    {
+        size_t received_size = size * nmemb;
+        struct layer_stream_parser* parser = (struct layer_stream_parser*)user_data;
+
+        if (parser->http_ok < 0)
+        {
+            long http_code = 0;
+            curl_easy_getinfo(parser->curl, CURLINFO_RESPONSE_CODE, &http_code);
+            parser->http_ok = (http_code >= 200 && http_code < 300);
+        }
+        if (!parser->http_ok)
+        {
+            // Keep error body for "get_http_response_body()"
+            return curl_body_callback(content, size, nmemb, parser->error_body);
+        }
+
+        if (xmlParseChunk(parser->ctxt, content, received_size, 0) != 0 || parser->failed)
+        {
+            if (!parser->failed) fprintf(stderr, "get_layers_stream(): xmlParseChunk failed\n");
+            parser->failed = true;
+            return 0; // Abort transfer
+        }
+        return received_size;
+    }
+
+    // Retry hook of "stream_layers()", names already passed can not be taken back
+    static bool restart_layer_stream(void* data)
+    {
+        struct layer_stream_parser* parser = (struct layer_stream_parser*)data;
+        if (parser->num_names > 0 || parser->failed) return false;
+
+        if (xmlCtxtResetPush(parser->ctxt, NULL, 0, NULL, NULL) != 0) return false;
+        parser->ctxt->_private = parser;
+        parser->depth = 0;
+        parser->in_name = false;
+        parser->http_ok = -1;
+        return true;
+    }
+
+    // CURL header callback, which stores catalog validators
+    static size_t validators_header_callback(char* buffer, size_t size,
+        size_t nitems, void* user_data)
+    {
+        size_t received_size = size * nitems;
+        struct catalog_validators* validators = (struct catalog_validators*)user_data;
+
+        std::string* target = NULL;
+        size_t name_len = 0;
+        if (received_size > 5 && strncasecmp(buffer, "ETag:", 5) == 0)
+        {
+            target = &validators->etag;
+            name_len = 5;
+        }
+        else if (received_size > 14 && strncasecmp(buffer, "Last-Modified:", 14) == 0)
+        {
+            target = &validators->last_modified;
+            name_len = 14;
+        }
+        if (!target) return received_size;
+
+        const char* begin = buffer + name_len;
+        const char* end = buffer + received_size;
+        while (begin < end && isspace((unsigned char)*begin)) begin++;
+        while (end > begin && isspace((unsigned char)*(end - 1))) end--;
+        target->assign(begin, end - begin);
+        return received_size;
+    }
+
+    bool get_layers_stream(const char* workspace, layer_name_callback on_layer,
+        void* user_data)
+    {
+        return stream_layers(workspace, on_layer, user_data, NULL, NULL);
+    }
+
+    bool stream_layers(const char* workspace, layer_name_callback on_layer,
+        void* user_data, struct catalog_validators* validators, bool* not_modified)
+    {
+        if (!on_layer)
+        {
+            fprintf(stderr, "get_layers_stream() on_layer parameter is NULL\n");
+            return false;
+        }
+
+        catalog_format format = layers_format;
+        struct http_request request;
+        if (!build_get_layers_request(geoserver_url, workspace, format, &request)) return false;
 
-            if (layer_names)
+        struct catalog_validators response_validators;
+        if (validators)
+        {
+            *not_modified = false;
+            if (!validators->etag.empty())
+            {
+                request.headers.push_back("If-None-Match: " + validators->etag);
+            }
+            if (!validators->last_modified.empty())
             {
-                for(size_t i=0; i < *num_layers; i++)
+                request.headers.push_back("If-Modified-Since: " + validators->last_modified);
+            }
+        }
+
+        pooled_handle handle;
+        if (!handle.entry) return false;
+
+        xmlSAXHandler sax;
+        memset(&sax, 0, sizeof(sax));
+        sax.initialized = XML_SAX2_MAGIC;
+        sax.startElementNs = stream_start_element;
+        sax.endElementNs = stream_end_element;
+        sax.characters = stream_characters;
+
+        struct layer_stream_parser parser;
+        parser.workspace = workspace;
+        parser.on_layer = on_layer;
+        parser.user_data = user_data;
+        parser.curl = handle.entry->curl;
+        parser.error_body = &handle.entry->response_body;
+        parser.ctxt = xmlCreatePushParserCtxt(&sax, NULL, NULL, 0, NULL);
+        if (!parser.ctxt)
+        {
+            fprintf(stderr, "get_layers_stream() xmlCreatePushParserCtxt failed\n");
+            return false;
+        }
+        parser.ctxt->_private = &parser;
+
+        // Hedged response is buffered, as only winner may reach "on_layer"
+        struct request_hooks hooks;
+        hooks.hedge = get_hedge_policy().enabled && !validators;
+        if (format == FORMAT_XML && !hooks.hedge)
+        {
+            curl_easy_setopt(handle.entry->curl, CURLOPT_WRITEFUNCTION, layer_stream_callback);
+            curl_easy_setopt(handle.entry->curl, CURLOPT_WRITEDATA, &parser);
+            hooks.before_retry = restart_layer_stream;
+            hooks.data = &parser;
+        }
+        if (validators)
+        {
+            curl_easy_setopt(handle.entry->curl, CURLOPT_HEADERFUNCTION,
+                validators_header_callback);
+            curl_easy_setopt(handle.entry->curl, CURLOPT_HEADERDATA, &response_validators);
+        }
+
+        CURLcode res = perform_request(handle.entry, request, metrics::OP_GET_LAYERS, &hooks);
+        bool status = (res == CURLE_OK);
+
+        long http_code = 0;
+        curl_easy_getinfo(handle.entry->curl, CURLINFO_RESPONSE_CODE, &http_code);
+        if (status && format == FORMAT_XML && hooks.hedge)
+        {
+            parser.http_ok = (http_code >= 200 && http_code < 300);
+            struct data_clb_pointer<char>& body = handle.entry->response_body;
+            if (parser.http_ok && body.length > 0)
+            {
+                if (xmlParseChunk(parser.ctxt, body.p, body.length, 0) != 0)
                 {
-                    if (layer_names[i]) free(layer_names[i]);
+                    fprintf(stderr, "get_layers_stream(): xmlParseChunk failed\n");
+                    parser.failed = true;
                 }
-                free(layer_names);
+                body.reset(); // Same as streamed response
             }
+            else if (parser.http_ok)
+            {
+                parser.http_ok = -1; // Empty response
+            }
+        }
+        if (status && validators && http_code == 304)
+        {
+            *not_modified = true;
+            xmlFreeParserCtxt(parser.ctxt);
+            return true;
+        }
+        if (res != CURLE_OK && !parser.failed)
+        {
+            fprintf(stderr, "get_layers_stream() curl_easy_perform failed: %d\n", res);
+        }
+        if (status && format == FORMAT_JSON)
+        {
+            // JSON response is buffered, then parsed at once
+            const struct data_clb_pointer<char>& body = handle.entry->response_body;
+            status = http_code >= 200 && http_code < 300 &&
+                parse_layers_json(body.p, body.length, workspace, on_layer, user_data);
+        }
+        else if (status && parser.http_ok == 1)
+        {
+            // Finish document
+            if (xmlParseChunk(parser.ctxt, NULL, 0, 1) != 0 || parser.failed ||
+                !parser.ctxt->wellFormed)
+            {
+                fprintf(stderr, "get_layers_stream() response is not valid XML\n");
+                status = false;
+            }
+        }
+        else if (status)
+        {
+            status = false; // Empty or error response
+        }
 
-            return status;
+        xmlFreeParserCtxt(parser.ctxt);
+        status = status && !parser.failed;
+        if (status && validators) *validators = response_validators;
+        return status;
     }
 
-} // end: namespace geoserver_api
+    static bool append_layer_name(const char* name, void* user_data)
+    {
+        if (!((struct layer_list*)user_data)->push_back(name))
+        {
+            fprintf(stderr, "Failed realloc\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Layer list request in progress, shared by threads asking for the same list
+    struct layers_flight
+    {
+        bool done = false;
+        bool status = false;
+        long http_code = 0;
+        int waiters = 0;
+        struct layer_list layers; // filled only if someone waits
+
+        ~layers_flight() { free_layer_list(&layers); }
+    };
+
+    // global variables
+    static std::mutex flight_mutex;
+    static std::condition_variable flight_cv;
+    static std::map<std::string, std::shared_ptr<layers_flight>> layer_flights;
+
+    static bool copy_layer_list(const struct layer_list& src, struct layer_list* dst)
+    {
+        dst->clear();
+        if (src.size() == 0) return true;
+        if (!dst->names.append(src.names.p, src.names.length) ||
+            !dst->offsets.append(src.offsets.p, src.offsets.length))
+        {
+            fprintf(stderr, "Failed realloc\n");
+            dst->clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool get_layers(const char* workspace, struct layer_list* layers)
+    {
+        if (catalog_cache_enabled()) return cached_get_layers(workspace, layers);
+
+        // Single flight: identical concurrent requests wait for the first one
+        std::string key = std::to_string(layers_format.load()) + " " +
+            std::to_string(catalog_generation()) + " " + ((workspace) ? workspace : "");
+        std::shared_ptr<layers_flight> flight;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lock(flight_mutex);
+            std::shared_ptr<layers_flight>& slot = layer_flights[key];
+            if (!slot)
+            {
+                slot = std::make_shared<layers_flight>();
+                leader = true;
+            }
+            else slot->waiters++;
+            flight = slot;
+        }
+
+        if (!leader)
+        {
+            std::unique_lock<std::mutex> lock(flight_mutex);
+            flight_cv.wait(lock, [&flight]{ return flight->done; });
+            lock.unlock();
+            set_last_http_code(flight->http_code);
+            if (!flight->status)
+            {
+                layers->clear();
+                return false;
+            }
+            return copy_layer_list(flight->layers, layers);
+        }
+
+        layers->clear();
+        bool status = get_layers_stream(workspace, append_layer_name, layers);
+        if (!status) layers->clear();
+        int waiters;
+        {
+            // Nobody joins after erase, so copy only for known waiters
+            std::lock_guard<std::mutex> lock(flight_mutex);
+            layer_flights.erase(key);
+            waiters = flight->waiters;
+        }
+        bool shared = status && (!waiters || copy_layer_list(*layers, &flight->layers));
+        {
+            std::lock_guard<std::mutex> lock(flight_mutex);
+            flight->status = shared;
+            flight->http_code = last_response.http_code;
+            flight->done = true;
+        }
+        flight_cv.notify_all();
+        return status;
+    }
 
+    void free_layer_list(struct layer_list* layers)
+    {
+        free(layers->names.p);
+        free(layers->offsets.p);
+        *layers = layer_list();
+    }
 
+    bool get_layers(const char* workspace, int* num_layers, char*** layer_names)
+    {
+        // Check inputs
+        if (*layer_names != NULL)
+        {
+            fprintf(stderr, "get_layers() layer_names parameter not NULL");
+            return false;
+        }
 
+        struct layer_list layers;
+        if (!get_layers(workspace, &layers))
+        {
+            free_layer_list(&layers);
+            return false;
+        }
 
+        // Allocate exact size at once
+        *num_layers = 0;
+        *layer_names = (char**)malloc(sizeof(char*) * (layers.size() + 1));
+        if (!*layer_names)
+        {
+            fprintf(stderr, "Failed malloc\n");
+            free_layer_list(&layers);
+            return false;
+        }
+        for (size_t i = 0; i < layers.size(); i++)
+        {
+            char* name = strdup(layers[i]);
+            if (!name)
+            {
+                // free all resource
+                fprintf(stderr, "Failed malloc\n");
+                for (int k = 0; k < *num_layers; k++) free((*layer_names)[k]);
+                free(*layer_names);
+                *layer_names = NULL;
+                *num_layers = 0;
+                free_layer_list(&layers);
+                return false;
+            }
+            (*layer_names)[i] = name;
+            (*num_layers)++;
+        }
+        free_layer_list(&layers);
+        return true;
+    }
+
+} // end: namespace geoserver_api
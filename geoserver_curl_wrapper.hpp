@@ -1,8 +1,14 @@
 #ifndef GEOSERVER_CURL_WRAPPER_H
 #define GEOSERVER_CURL_WRAPPER_H
 
+#include <stdint.h>
+
+#include <string>
+
 #include <curl/curl.h>
 
+#include "geoserver_custom_structs.hpp"
+
 /** This curl wrapper allows to interact easily with geoserver.
  * These functions expects, that all layers are made in workspaces
  * in Geoserver. More info about Geoserver RETS API:
@@ -11,6 +17,54 @@
 
 namespace geoserver_api
 {
+    enum http_version
+    {
+        HTTP_1_1,
+        HTTP_2, // HTTP/2 negotiated with ALPN or "Upgrade: h2c", falls back to HTTP/1.1
+        HTTP_2_PRIOR_KNOWLEDGE // HTTP/2 without TLS (h2c) from first byte, server must support it
+    };
+
+    /**
+     * @brief Options of "init()". Strings are copied, they must be valid
+     * only during "init()" call.
+     */
+    struct init_options
+    {
+        const char* hostname = "localhost";
+        int port = 8080;
+        const char* username = "admin";
+        const char* password = "geoserver";
+        int timeout_s = 3;
+        int pool_size = 4; // see "init()"
+
+        // With HTTP/2 concurrent async requests are multiplexed over one
+        // connection. Sync requests use own connection per pool handle.
+        http_version version = HTTP_1_1;
+        bool tcp_keepalive = true;
+        long keepalive_idle_s = 60; // idle time before first keep-alive probe
+        long keepalive_interval_s = 60; // time between keep-alive probes
+        bool tcp_nodelay = true; // disable Nagle algorithm
+        long max_host_connections = 0; // async connections per host, 0 - no limit
+        bool share_dns_cache = true; // resolve hostname once for all handles
+
+        // Compression. Responses are decoded while received, so streaming
+        // parser and response body see plain data.
+        bool accept_encoding = true; // advertise gzip, deflate, br and zstd
+        // Send request bodies of at least this size with "Content-Encoding: gzip",
+        // 0 - never. Geoserver (or proxy in front of it) must decode them.
+        long gzip_request_min_bytes = 0;
+
+        // TLS, used only with "use_https"
+        bool use_https = false;
+        const char* ca_file = NULL; // CA bundle, NULL - system default
+        const char* ca_path = NULL; // directory with CA certificates
+        const char* client_cert = NULL; // client certificate (PEM), if required
+        const char* client_key = NULL; // client certificate key (PEM)
+        bool verify_peer = true; // verify server certificate
+        bool verify_host = true; // verify certificate matches hostname
+        bool tls_session_cache = true; // share TLS sessions between handles
+    };
+
     /**
      * @brief Function to initialize "geoserver_curl_wrapper" lib.
      * You must call "cleanup()" function aferwards to free resource.
@@ -20,39 +74,93 @@ namespace geoserver_api
      * @param username Geoserver username with r/w access
      * @param password Geoserver password with r/w access
      * @param timeout_s CURL timeout in seconds
+     * @param pool_size number of CURL handles kept in the handle pool. It
+     * limits how many requests can be in flight at once from different threads.
      * 
      * @returns boolean to indicate wether success or not
      */
     bool init(const char* hostname, const int port,
-        const char* username, const char* password, const int timeout_s);
+        const char* username, const char* password, const int timeout_s,
+        const int pool_size=4);
+
+    /**
+     * @brief Initialize "geoserver_curl_wrapper" lib with connection tuning
+     * options, see "init_options". Fails if HTTP/2 is requested, but libcurl
+     * is built without HTTP/2 support.
+     * 
+     * @returns boolean to indicate wether success or not
+     */
+    bool init(const struct init_options& options);
 
     /**
      * @brief Clean allocated resources for "geoserver_curl_wrapper" lib
      */
     void cleanup();
 
+    /**
+     * @brief Open connections of handle pool ahead of time, so the first
+     * requests do not pay connect and TLS handshake latency. Every handle
+     * sends HEAD request to REST root, handles are connected in parallel.
+     * 
+     * @param connections number of handles to connect, at most pool size
+     * 
+     * @returns number of connected handles
+     */
+    int warm_up(const int connections);
+
     /**
      * @brief Function to get curl handle for detailed operations.
-     * It allows to create custom requests if needed.
+     * It allows to create custom requests if needed. This handle is not
+     * part of the handle pool and must not be used from several threads
+     * at once. Prefer "acquire_curl_handle()" in multithreaded code.
      * 
      * @returns CURL handle
      */
     CURL* get_curl_handle();
 
     /**
-     * @brief Get http response code from last request
+     * @brief Check out a configured CURL handle from the handle pool for
+     * custom requests. Blocks until a handle is free. Response body is
+     * collected by the pool, return the handle with "release_curl_handle()".
+     * 
+     * @returns CURL handle or NULL if lib is not initialized
+     */
+    CURL* acquire_curl_handle();
+
+    /**
+     * @brief Return handle received from "acquire_curl_handle()" to the pool.
+     * Response code and body of the last request made on the handle become
+     * available through "get_http_response_code()" and "get_http_response_body()".
+     * 
+     * @param curl handle to return
+     */
+    void release_curl_handle(CURL* curl);
+
+    /**
+     * @brief Get http response code from last request made by calling thread
      * 
      * @returns http code or 0 if no code
      */
     long get_http_response_code();
 
     /**
-     * @brief Get http response body from last request.If no body
-     * is available, returns NULL.
+     * @brief Get http response body from last request made by calling thread.
+     * If no body is available, returns NULL. Pointer stays valid until
+     * the next request on the same thread.
      * 
      * @returns response body or NULL if no body
      */
     char* get_http_response_body();
+
+    /**
+     * @brief Get http response body from last request made by calling thread
+     * as pointer and length. Unlike "get_http_response_body()" it does not
+     * require scanning for terminating 0. View stays valid until the next
+     * request on the same thread.
+     * 
+     * @returns view of response body, data is NULL if no body
+     */
+    struct data_view get_http_response_view();
      
     /**
      * @brief Function to create layer in Geoserver. It expects that
@@ -90,9 +198,95 @@ namespace geoserver_api
     bool add_style(const char* layer_name, const char* style_name,
         const char* layer_workspace="forestAI", const char* style_workspace="forestAI");
     
+    /**
+     * @brief Layer of layer group, for adding layers from container
+     * with "layer_group_builder::add(begin, end)".
+     */
+    struct layer_group_entry
+    {
+        std::string workspace;
+        std::string layer_name; // without workspace
+        std::string style_name; // empty - default style of layer
+        std::string style_workspace; // empty - global style
+    };
+
+    /**
+     * @brief Layers of layer group for "create_layer_group()" in drawing
+     * order. Layers can be from different workspaces and each can have own
+     * style. XML is appended to growing buffer as layers are added, so group
+     * of n layers is built in O(n) time without size limit.
+     */
+    class layer_group_builder
+    {
+    public:
+        /**
+         * @brief Add layer at the end of group
+         * 
+         * @param workspace workspace of the layer
+         * @param layer_name layer name without workspace
+         * @param style_name style used in group, NULL - default style of layer
+         * @param style_workspace workspace of the style, NULL - global style
+         * 
+         * @returns false if workspace or layer name is missing
+         */
+        bool add(const char* workspace, const char* layer_name,
+            const char* style_name=NULL, const char* style_workspace=NULL);
+
+        /**
+         * @brief Add layers from range of "layer_group_entry"
+         * 
+         * @returns false if any entry is invalid, valid entries before it are added
+         */
+        template <typename Iterator>
+        bool add(Iterator begin, Iterator end)
+        {
+            for (Iterator it = begin; it != end; ++it)
+            {
+                const struct layer_group_entry& entry = *it;
+                if (!add(entry.workspace.c_str(), entry.layer_name.c_str(),
+                    (entry.style_name.empty()) ? NULL : entry.style_name.c_str(),
+                    (entry.style_workspace.empty()) ? NULL : entry.style_workspace.c_str()))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t size() const
+        {
+            return num_layers;
+        }
+
+        /**
+         * @brief Remove all layers, memory is kept for reuse
+         */
+        void clear();
+
+        // "<published>" elements, content of "<publishables>"
+        const std::string& publishables() const
+        {
+            return published_xml;
+        }
+
+        // "<style>" elements, content of "<styles>", empty if no layer has own style
+        const std::string& styles() const
+        {
+            return (has_styles) ? styles_xml : empty_styles;
+        }
+
+    private:
+        std::string published_xml;
+        std::string styles_xml; // one element per layer, "<style/>" for default
+        size_t num_layers = 0;
+        bool has_styles = false;
+        static const std::string empty_styles;
+    };
+
     /**
      * @brief This function is used to prepare layer structure for layer
-     * goup creation. 
+     * goup creation. Prefer "layer_group_builder", which has no varargs
+     * and supports styles and layers from several workspaces.
      * 
      * @param workspace workspace name for layers to be used
      * @param number_layers number of layers passed in this function
@@ -104,7 +298,7 @@ namespace geoserver_api
     char* prepare_layer_group(const char* workspace, int number_layers, ...);
 
     /**
-     * @brief Function to create layer group - combine exactly 2 layers in one.
+     * @brief Function to create layer group. 
      * 
      * @param layer_group_name name of the layer group to be made
      * @param layer_title title of the layer group to be made
@@ -120,6 +314,101 @@ namespace geoserver_api
         const char* const layer_structure, const char* workspace="forestAI",
         const bool advertised=true);
 
+    /**
+     * @brief Create layer group from layers of "layers" with their styles,
+     * see "layer_group_builder".
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 201 on success
+     */
+    bool create_layer_group(const char* layer_group_name, const char* layer_title,
+        const layer_group_builder& layers, const char* workspace="forestAI",
+        const bool advertised=true);
+
+    /**
+     * @brief Replace title and layers of existing layer group.
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 200 on success
+     */
+    bool update_layer_group(const char* layer_group_name, const char* layer_title,
+        const layer_group_builder& layers, const char* workspace="forestAI",
+        const bool advertised=true);
+
+    /**
+     * @brief Delete layer together with its feature type, created by
+     * "create_layer()". Layer must not be part of any layer group.
+     * 
+     * @param layer_name name of the layer
+     * @param workspace workspace for datastore and layer
+     * @param datastore datastore name
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 200 on success
+     */
+    bool delete_layer(const char* layer_name, const char* workspace="forestAI",
+        const char* datastore="postgis");
+
+    /**
+     * @brief Delete layer group, its layers are kept.
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 200 on success
+     */
+    bool delete_layer_group(const char* layer_group_name, const char* workspace="forestAI");
+
+    /**
+     * @brief Progress callback of file upload, called by libcurl while
+     * upload runs (at least once per second).
+     * 
+     * @returns false to abort upload
+     */
+    typedef bool (*upload_progress_callback)(uint64_t sent_bytes, uint64_t total_bytes,
+        void* user_data);
+
+    /**
+     * @brief Result of file upload
+     */
+    struct upload_stats
+    {
+        uint64_t bytes = 0; // request body bytes sent
+        double seconds = 0; // whole request, including Geoserver processing
+        double bytes_per_s = 0; // average upload speed
+    };
+
+    /**
+     * @brief Upload GeoTIFF file to coverage store. Store is created if it does
+     * not exist. File is memory mapped and streamed to socket, so it is never
+     * copied whole into memory. Request timeout does not apply, upload is
+     * aborted if nothing was sent for "timeout_s".
+     * 
+     * @param file_path path to GeoTIFF file
+     * @param coverage_store name of the coverage store
+     * @param workspace name of the workspace of coverage store
+     * @param on_progress optional progress callback
+     * @param user_data passed to "on_progress"
+     * @param stats optional storage for upload size and speed
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 201 on success
+     */
+    bool upload_geotiff(const char* file_path, const char* coverage_store,
+        const char* workspace="forestAI", upload_progress_callback on_progress=NULL,
+        void* user_data=NULL, struct upload_stats* stats=NULL);
+
+    /**
+     * @brief Upload zipped shapefile to datastore, same as "upload_geotiff()".
+     * 
+     * @param zip_path path to zip archive with shapefile (.shp, .shx, .dbf, ...)
+     * @param datastore name of the datastore
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 201 on success
+     */
+    bool upload_shapefile(const char* zip_path, const char* datastore,
+        const char* workspace="forestAI", upload_progress_callback on_progress=NULL,
+        void* user_data=NULL, struct upload_stats* stats=NULL);
+
     
     /**
      * @brief Callback function for curl request to store response body. 
@@ -140,7 +429,8 @@ namespace geoserver_api
      * @brief Gett all layers from Geoserve rin form of {worksapce}:{layername}
      * 
      * @param workspace determine which workspace layers to return.
-     * If NULL, returns all layers.
+     * If NULL, returns all layers. Workspace layers are requested from
+     * workspace endpoint, so other layers are not downloaded.
      * @param num_layers storage for number of layers returned
      * @param layer_names storage for actual layer names which are returned.
      * Remember to free this pointer in 1st and 2nd dimension.
@@ -149,6 +439,225 @@ namespace geoserver_api
      * Use "get_http_response_code()" function to check HTTP status code. 200 on success
      */
     bool get_layers(const char* workspace, int* num_layers, char*** layer_names);
+
+    /**
+     * @brief Get all layers from Geoserver in form of {worksapce}:{layername}.
+     * All names are stored in single arena of "layers", which can be reused
+     * for next calls. Concurrent calls with the same workspace share single
+     * request and parse, unless catalog was written after it started. Threads
+     * which joined other thread's request get its status code, but no body.
+     * 
+     * @param workspace determine which workspace layers to return.
+     * If NULL, returns all layers.
+     * @param layers storage for layer names, previous content is removed.
+     * Remember to free it with "free_layer_list()".
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 200 on success
+     */
+    bool get_layers(const char* workspace, struct layer_list* layers);
+
+    /**
+     * @brief Get layer groups of workspace in form of {workspace}:{groupname}.
+     * Layer group names are stored in "layer_list" like layer names.
+     * 
+     * @param workspace workspace of layer groups, must not be NULL or empty
+     * @param groups storage for layer group names, previous content is removed.
+     * Remember to free it with "free_layer_list()".
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 200 on success
+     */
+    bool get_layer_groups(const char* workspace, struct layer_list* groups);
+
+    /**
+     * @brief Free memory of layer list filled by "get_layers()"
+     */
+    void free_layer_list(struct layer_list* layers);
+
+    /**
+     * @brief Callback called for every layer name found by parser.
+     * 
+     * @param name layer name in form of {worksapce}:{layername}. Pointer is
+     * valid only during callback.
+     * @param user_data pointer passed to function which started parsing
+     * 
+     * @returns false to stop parsing and abort request
+     */
+    typedef bool (*layer_name_callback)(const char* name, void* user_data);
+
+    /**
+     * @brief Streaming version of "get_layers()". Response is parsed while it
+     * is received, each layer name is passed to "on_layer" as soon as its
+     * element closes. Neither response nor document tree are kept in memory,
+     * so memory use does not depend on number of layers.
+     * 
+     * @param workspace determine which workspace layers to return.
+     * If NULL, returns all layers.
+     * @param on_layer callback called for every layer name
+     * @param user_data pointer passed to "on_layer"
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     * Use "get_http_response_code()" function to check HTTP status code. 200 on success
+     */
+    bool get_layers_stream(const char* workspace, layer_name_callback on_layer,
+        void* user_data);
+
+    enum catalog_format
+    {
+        FORMAT_XML,
+        FORMAT_JSON
+    };
+
+    /**
+     * @brief Select response format used by "get_layers()" functions.
+     * XML is parsed while it is received, JSON response is buffered and
+     * parsed by fast non-allocating parser. Default is FORMAT_XML.
+     */
+    void set_catalog_format(const catalog_format format);
+
+    /**
+     * @brief Get response format used by "get_layers()" functions
+     */
+    catalog_format get_catalog_format();
+
+    /**
+     * @brief Enable client-side cache of layer list used by "get_layers()" and
+     * "layer_exists()". Cached list younger than "ttl_s" is served without
+     * request, older one is revalidated with conditional GET (If-None-Match,
+     * If-Modified-Since), so unchanged catalog costs only 304 response. Cache
+     * is invalidated by every successful "create_layer()", "add_style()" and
+     * "create_layer_group()" call. "get_http_response_code()" returns 200
+     * when list was served from cache and 304 when it was revalidated.
+     * 
+     * @param ttl_s time in seconds, for which cached list is used without
+     * revalidation
+     */
+    void enable_catalog_cache(const int ttl_s);
+
+    /**
+     * @brief Disable catalog cache and free cached layer list
+     */
+    void disable_catalog_cache();
+
+    /**
+     * @brief Force next catalog read to download full layer list
+     */
+    void invalidate_catalog_cache();
+
+    /**
+     * @brief Persist catalog cache in binary snapshot file "path" (sorted name
+     * table and string pool) for warm start. If snapshot of this Geoserver
+     * exists, it is memory mapped and served as fresh cached list right away,
+     * while background thread revalidates it with conditional GET. Snapshot is
+     * rewritten (atomically, by rename) after every download of changed list.
+     * Names served from snapshot are sorted. Catalog cache must be enabled
+     * and "init()" called first.
+     * 
+     * @param path snapshot file, created if missing
+     * 
+     * @returns true if snapshot was loaded, false if there was no usable
+     * snapshot (it is still written after next download)
+     */
+    bool enable_catalog_snapshot(const char* path);
+
+    /**
+     * @brief Wait until background revalidation of loaded snapshot is done.
+     * Also called by "cleanup()".
+     * 
+     * @returns HTTP status code of revalidation: 304 if snapshot was current,
+     * 200 if newer list was downloaded, 0 if there was no revalidation or it failed
+     */
+    long wait_catalog_revalidation();
+
+    /**
+     * @brief Stop writing snapshot file, cached list stays in memory
+     */
+    void disable_catalog_snapshot();
+
+    /**
+     * @brief Check wether layer exists in Geoserver. With catalog cache
+     * enabled, it does not make request while cache is fresh.
+     * 
+     * @param layer_name layer name in form of {worksapce}:{layername}
+     * @param exists storage for result
+     * 
+     * @returns boolean to indicate wether successful function call or not.
+     */
+    bool layer_exists(const char* layer_name, bool* exists);
+
+    /**
+     * @brief Retry of failed requests. Only idempotent requests (GET, HEAD,
+     * PUT, DELETE) are retried, on HTTP status 429, 503 and on connection failures
+     * (refused or reset connection, empty response). "create_layer()" and
+     * "create_layer_group()" (POST) are never retried.
+     */
+    struct retry_policy
+    {
+        int max_attempts = 1; // 1 - no retries
+        long base_delay_ms = 50; // delay before first retry, doubles with every retry
+        long max_delay_ms = 2000;
+        double jitter = 1.0; // 0 - exact delay, 1 - random delay in 0..delay
+        bool respect_retry_after = true; // use "Retry-After" header, up to max_delay_ms
+    };
+
+    void set_retry_policy(const struct retry_policy& policy);
+    struct retry_policy get_retry_policy();
+
+    /**
+     * @brief Hedging of layer list reads. If response does not arrive in
+     * "percentile" of recent "get_layers()" latency, the same request is sent
+     * on another free pool handle and the first response wins, the other
+     * request is aborted. Writes and catalog cache revalidation are not hedged.
+     * Hedged XML response is parsed after it is received, not while streaming.
+     */
+    struct hedge_policy
+    {
+        bool enabled = false;
+        double percentile = 0.95; // latency percentile used as hedge delay
+        long initial_delay_ms = 100; // delay until "min_samples" requests are measured
+        long min_delay_ms = 5;
+        long max_delay_ms = 2000;
+        int min_samples = 20;
+    };
+
+    void set_hedge_policy(const struct hedge_policy& policy);
+    struct hedge_policy get_hedge_policy();
+
+    /**
+     * @brief Adaptive limit of requests in flight (AIMD), shared by blocking
+     * and async calls. Limit grows by one per round of requests while latency
+     * is stable and is multiplied by "backoff" on 429 or 503 response, timeout
+     * or when recent latency exceeds "latency_tolerance" times no-load latency.
+     * Blocking calls wait for free slot, async requests stay queued. Setting
+     * policy restarts from "initial_limit".
+     */
+    struct concurrency_limit
+    {
+        bool enabled = false;
+        int initial_limit = 4;
+        int min_limit = 1;
+        int max_limit = 256;
+        double backoff = 0.7; // limit multiplier on overload, 0..1
+        double latency_tolerance = 2.0; // latency spike, times no-load latency
+        int min_samples = 10; // latency samples needed for spike detection
+    };
+
+    void set_concurrency_limit(const struct concurrency_limit& limit);
+    struct concurrency_limit get_concurrency_limit();
+
+    struct concurrency_limit_stats
+    {
+        int limit = 0; // current limit, 0 if disabled
+        int in_flight = 0;
+        uint64_t decreases = 0;
+        uint64_t overloads = 0; // 429, 503 and timeouts
+        uint64_t latency_spikes = 0;
+        double baseline_ms = 0; // no-load latency estimate
+        double latency_ms = 0; // recent latency
+    };
+
+    struct concurrency_limit_stats get_concurrency_limit_stats();
    
 
 
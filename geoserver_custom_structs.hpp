@@ -1,27 +1,145 @@
 #ifndef GEOSERVER_CUSTOM_STRUCTS_HPP
 #define GEOSERVER_CUSTOM_STRUCTS_HPP
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+
 namespace geoserver_api
 {
+    /**
+     * @brief Growable buffer used as CURL response storage. "size" is
+     * allocated capacity, "length" is number of used elements. Storage
+     * is always terminated by 0 after "length" elements, so char buffer
+     * can be used as C string. Capacity is kept between requests.
+     */
     template <typename T>
     struct data_clb_pointer
     {
         size_t size = 0;
+        size_t length = 0;
         T* p = NULL;
 
+        /**
+         * @brief Truncate content to "start_idx" elements, capacity is kept
+         */
         void reset(size_t start_idx=0)
         {
             if (size == 0) return;
-            if (start_idx >= size)
+            if (start_idx > length)
             {
                 fprintf(stderr, "Pointer reset index out of " \
-                    "range: %ld, but size is: %ld", start_idx, size);
+                    "range: %ld, but length is: %ld", start_idx, length);
                 return;
             }
-            size_t reset_size = size - start_idx;
-            if (p) memset(p + start_idx, 0, reset_size);
+            length = start_idx;
+            p[length] = 0;
+        }
+
+        /**
+         * @brief Make sure capacity is at least "needed" elements plus
+         * terminating 0. Capacity grows geometrically.
+         * 
+         * @returns false if allocation failed
+         */
+        bool reserve(size_t needed)
+        {
+            if (needed + 1 <= size) return true;
+            size_t new_size = (size < 1024) ? 1024 : size;
+            while (new_size < needed + 1) new_size *= 2;
+
+            T* tmp = (T*)realloc(p, new_size * sizeof(T));
+            if (tmp == NULL) return false;
+            if (p == NULL) tmp[0] = 0;
+            p = tmp;
+            size = new_size;
+            return true;
+        }
+
+        /**
+         * @brief Append "count" elements at the end of content
+         * 
+         * @returns false if allocation failed
+         */
+        bool append(const T* data, size_t count)
+        {
+            if (!reserve(length + count)) return false;
+            memcpy(p + length, data, count * sizeof(T));
+            length += count;
+            p[length] = 0;
+            return true;
         }
     };
+
+    /**
+     * @brief Read-only view of data, it does not own memory
+     */
+    struct data_view
+    {
+        const char* data = NULL;
+        size_t size = 0;
+    };
+
+    /**
+     * @brief List of layer names stored in single contiguous arena.
+     * Names are terminated by 0 and addressed by offsets array, both
+     * grow geometrically. Free with "free_layer_list()".
+     */
+    struct layer_list
+    {
+        struct data_clb_pointer<char> names;
+        struct data_clb_pointer<size_t> offsets;
+
+        size_t size() const
+        {
+            return offsets.length;
+        }
+
+        const char* operator[](size_t idx) const
+        {
+            return names.p + offsets.p[idx];
+        }
+
+        /**
+         * @brief Append copy of name at the end of list
+         * 
+         * @returns false if allocation failed
+         */
+        bool push_back(const char* name)
+        {
+            size_t offset = names.length;
+            if (!names.append(name, strlen(name) + 1)) return false; // with \0
+            if (!offsets.append(&offset, 1))
+            {
+                names.reset(offset);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Remove all names, memory is kept for reuse
+         */
+        void clear()
+        {
+            names.reset();
+            offsets.reset();
+        }
+    };
+
+    /**
+     * @brief Single slot of CURL handle pool. Every handle has its own
+     * response body storage, so requests on different handles
+     * do not interfere with each other.
+     */
+    struct curl_pool_entry
+    {
+        CURL* curl = NULL;
+        CURLM* multi = NULL; // runs transfers of "curl" and keeps its connections
+        struct data_clb_pointer<char> response_body;
+    };
 }
 
 #endif
\ No newline at end of file
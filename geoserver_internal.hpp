@@ -0,0 +1,298 @@
+#ifndef GEOSERVER_INTERNAL_HPP
+#define GEOSERVER_INTERNAL_HPP
+
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include "geoserver_curl_wrapper.hpp"
+#include "geoserver_async.hpp"
+#include "geoserver_custom_structs.hpp"
+#include "geoserver_metrics.hpp"
+
+/** Internal interface shared between "geoserver_curl_wrapper" translation
+ * units. It is not part of public API.
+ */
+
+namespace geoserver_api
+{
+    /**
+     * @brief Memory mapped file sent as request body
+     */
+    struct upload_source
+    {
+        const char* data = NULL;
+        size_t size = 0;
+        size_t offset = 0; // next byte to send
+        upload_progress_callback on_progress = NULL;
+        void* user_data = NULL;
+    };
+
+    /**
+     * @brief Description of single REST request, independent of
+     * CURL handle which will execute it.
+     */
+    struct http_request
+    {
+        std::string url;
+        const char* method = "GET"; // "GET", "HEAD", "POST", "PUT" or "DELETE"
+        std::string body;
+        struct upload_source* upload = NULL; // PUT body streamed instead of "body"
+        bool xml_body = false; // adds "Content-type: application/xml" header
+        std::vector<std::string> headers; // additional headers
+    };
+
+    /**
+     * @brief Validators of cached catalog for conditional GET
+     */
+    struct catalog_validators
+    {
+        std::string etag;
+        std::string last_modified;
+    };
+
+    /**
+     * @brief Get base REST url, set by "init()" function
+     */
+    const char* get_base_url();
+
+    /**
+     * @brief Build REST url of other Geoserver node, with scheme set by "init()"
+     */
+    bool make_base_url(const char* hostname, const int port, std::string* url);
+
+    /**
+     * @brief Limit of connections per host set by "init()", 0 - no limit
+     */
+    long get_max_host_connections();
+
+    /**
+     * @brief Set http code returned by "get_http_response_code()"
+     * for calling thread, used when response is served without request.
+     */
+    void set_last_http_code(long http_code);
+
+    /**
+     * @brief Check wether request changes catalog and succeeded.
+     * Such request invalidates catalog cache.
+     */
+    bool is_catalog_write(const struct http_request& request, CURLcode res,
+        long http_code);
+
+    /**
+     * @brief Set options common for all handles used by lib:
+     * timeouts, credentials and response body storage.
+     */
+    void apply_handle_options(CURL* handle, struct data_clb_pointer<char>* body);
+
+    /**
+     * @brief Set url, method, body and headers of request on handle.
+     * 
+     * @param header storage for header list. Free it after request is done.
+     */
+    void setup_request(CURL* handle, const struct http_request& request,
+        struct curl_slist** header);
+
+    /**
+     * @brief Send prepared request on pool handle and wait for response,
+     * which is left for calling thread ("get_http_response_view()").
+     * 
+     * @param function_name used in error message
+     */
+    bool send_request(const char* function_name, const struct http_request& request,
+        const metrics::operation op);
+
+    /**
+     * @brief Read libcurl timing of finished request into "timing" (can be
+     * NULL) and record it into histograms of "op".
+     */
+    void record_request(const metrics::operation op, CURL* handle, CURLcode res,
+        long http_code, struct metrics::request_timing* timing);
+
+    /**
+     * @brief Count retry or hedge request of "op" in metrics. Hedge request
+     * is counted once when sent and once more when it wins.
+     */
+    void record_retry(const metrics::operation op);
+    void record_hedge(const metrics::operation op, const bool won);
+
+    /**
+     * @brief Record time async job of "op" waited in scheduler queue
+     */
+    void record_queue_wait(const metrics::operation op, const double wait_s);
+
+    /**
+     * @brief HTTP status code worth retrying: 429 and 503
+     */
+    bool is_retryable_status(long http_code);
+
+    /**
+     * @brief Check wether failed request can be retried by retry policy
+     */
+    bool is_retryable(const struct http_request& request, CURLcode res, long http_code);
+
+    /**
+     * @brief Delay before retry number "attempt" (1 for first retry)
+     * 
+     * @param retry_after_s value of "Retry-After" header, 0 if missing
+     */
+    long retry_delay_ms(const struct retry_policy& policy, int attempt,
+        curl_off_t retry_after_s);
+
+    /**
+     * @brief Delay before hedge request, based on latency histogram of "op"
+     */
+    long hedge_delay_ms(const struct hedge_policy& policy, const metrics::operation op);
+
+    /**
+     * @brief Slot of adaptive concurrency limit held by single request attempt
+     */
+    struct limiter_slot
+    {
+        bool acquired = false; // false if limit was disabled
+        uint64_t sequence = 0; // order of acquiring, older slots do not decrease limit
+    };
+
+    /**
+     * @brief Wait for free slot of "concurrency_limit", returns at once if disabled
+     */
+    void acquire_limiter_slot(struct limiter_slot* slot);
+
+    /**
+     * @brief Take free slot without waiting. Succeeds without slot if disabled.
+     * 
+     * @returns false if limit is reached
+     */
+    bool try_acquire_limiter_slot(struct limiter_slot* slot);
+
+    /**
+     * @brief Return slot and adjust limit by outcome of request
+     * 
+     * @param latency_s libcurl total time of request
+     */
+    void release_limiter_slot(struct limiter_slot* slot, CURLcode res, long http_code,
+        double latency_s);
+
+    bool build_create_layer_request(const char* base_url, const char* layer_name,
+        const char* layer_title, const char* postgis_table_name, const char* filter,
+        const char* workspace, const char* datastore, const bool advertised,
+        struct http_request* request);
+
+    bool build_add_style_request(const char* base_url, const char* layer_name,
+        const char* style_name, const char* layer_workspace, const char* style_workspace,
+        struct http_request* request);
+
+    /**
+     * @param styles content of "<styles>", NULL or empty to use default styles
+     */
+    bool build_create_layer_group_request(const char* base_url,
+        const char* layer_group_name, const char* layer_title,
+        const char* const layer_structure, const char* styles, const char* workspace,
+        const bool advertised, struct http_request* request);
+
+    /**
+     * @brief Build PUT of layer group document to existing layer group
+     */
+    bool build_update_layer_group_request(const char* base_url,
+        const char* layer_group_name, const char* layer_title,
+        const char* const layer_structure, const char* styles, const char* workspace,
+        const bool advertised, struct http_request* request);
+
+    bool build_delete_layer_request(const char* base_url, const char* layer_name,
+        const char* workspace, const char* datastore, struct http_request* request);
+
+    bool build_delete_layer_group_request(const char* base_url,
+        const char* layer_group_name, const char* workspace, struct http_request* request);
+
+    /**
+     * @brief Build request of layer group list of workspace (XML)
+     */
+    bool build_get_layer_groups_request(const char* base_url, const char* workspace,
+        struct http_request* request);
+
+    /**
+     * @brief Build request of single layer or layer group document (XML)
+     */
+    bool build_get_layer_request(const char* base_url, const char* layer_name,
+        const char* workspace, struct http_request* request);
+    bool build_get_layer_group_request(const char* base_url, const char* layer_group_name,
+        const char* workspace, struct http_request* request);
+
+    /**
+     * @brief Build HEAD request to "/about/version.xml" used to open connection
+     */
+    bool build_warm_up_request(const char* base_url, struct http_request* request);
+
+    /**
+     * @brief Build layer list request. If workspace is given, workspace
+     * scoped endpoint is used.
+     */
+    bool build_get_layers_request(const char* base_url, const char* workspace,
+        const catalog_format format, struct http_request* request);
+
+    /**
+     * @brief Pass layer name to "on_layer" in form of {workspace}:{layername}.
+     * Whitespace is removed, names without workspace get "workspace" prefix
+     * and names from other workspace are skipped. If workspace is NULL,
+     * all names are passed as they are.
+     * 
+     * @returns false if name is invalid or "on_layer" stopped parsing
+     */
+    bool emit_layer_name(const char* raw_name, size_t len, const char* workspace,
+        layer_name_callback on_layer, void* user_data);
+
+    /**
+     * @brief Parse "layers.xml" response (libxml2 DOM) and call "on_layer"
+     * for every layer, see "emit_layer_name()".
+     */
+    bool parse_layers_xml(const char* data, size_t len, const char* workspace,
+        layer_name_callback on_layer, void* user_data);
+
+    /**
+     * @brief Parse "layers.json" response and call "on_layer"
+     * for every layer, see "emit_layer_name()".
+     */
+    bool parse_layers_json(const char* data, size_t len, const char* workspace,
+        layer_name_callback on_layer, void* user_data);
+
+    /**
+     * @brief Streaming fetch of layer list, see "get_layers_stream()".
+     * 
+     * @param validators if not NULL, validators are sent as conditional
+     * GET headers and replaced with validators of response
+     * @param not_modified set to true if server responded 304, then
+     * "on_layer" is not called. Can be NULL if "validators" is NULL.
+     */
+    bool stream_layers(const char* workspace, layer_name_callback on_layer,
+        void* user_data, struct catalog_validators* validators, bool* not_modified);
+
+    /**
+     * @brief Wether catalog cache is enabled
+     */
+    bool catalog_cache_enabled();
+
+    /**
+     * @brief Serve layer list from catalog cache, revalidating it if needed
+     */
+    bool cached_get_layers(const char* workspace, struct layer_list* layers);
+
+    /**
+     * @brief Counter of catalog writes ("invalidate_catalog_cache()" calls).
+     * Reads started before write must not be shared with readers after it.
+     */
+    unsigned long catalog_generation();
+
+namespace async
+{
+    /**
+     * @brief Queue prepared request on event-loop, used for requests
+     * to other nodes than "init()" one.
+     */
+    std::future<response> submit_request(const struct http_request& request,
+        const metrics::operation op, completion_callback callback);
+
+} // end: namespace async
+} // end: namespace geoserver_api
+
+#endif
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "geoserver_internal.hpp"
+
+/** Minimal JSON parser for Geoserver "layers.json" responses:
+ * {"layers":{"layer":[{"name":"ws:name","href":"..."}, ...]}}
+ * Empty list is returned as {"layers":""} and single layer may be
+ * returned as object instead of array. Parser works directly on
+ * response buffer and does not allocate memory.
+ */
+
+namespace geoserver_api
+{
+    struct json_cursor
+    {
+        const char* p;
+        const char* end;
+    };
+
+    static void skip_whitespace(struct json_cursor* cur)
+    {
+        while (cur->p < cur->end && (*cur->p == ' ' || *cur->p == '\n' ||
+            *cur->p == '\r' || *cur->p == '\t'))
+        {
+            cur->p++;
+        }
+    }
+
+    static bool expect(struct json_cursor* cur, char c)
+    {
+        skip_whitespace(cur);
+        if (cur->p >= cur->end || *cur->p != c) return false;
+        cur->p++;
+        return true;
+    }
+
+    static bool peek(struct json_cursor* cur, char c)
+    {
+        skip_whitespace(cur);
+        return cur->p < cur->end && *cur->p == c;
+    }
+
+    static int hex_value(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static bool read_hex4(struct json_cursor* cur, unsigned int* code)
+    {
+        if (cur->end - cur->p < 4) return false;
+        *code = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            int v = hex_value(*cur->p++);
+            if (v < 0) return false;
+            *code = (*code << 4) | v;
+        }
+        return true;
+    }
+
+    /**
+     * Read string at cursor. If "out" is not NULL, decoded string is stored
+     * there (max "out_size" bytes, not 0 terminated), otherwise it is skipped.
+     */
+    static bool read_string(struct json_cursor* cur, char* out, size_t out_size,
+        size_t* out_len)
+    {
+        if (!expect(cur, '"')) return false;
+        size_t len = 0;
+        auto put = [&](char c) -> bool
+        {
+            if (!out) return true;
+            if (len >= out_size) return false;
+            out[len++] = c;
+            return true;
+        };
+
+        while (cur->p < cur->end)
+        {
+            // Copy plain run at once
+            const char* run = cur->p;
+            while (cur->p < cur->end && *cur->p != '"' && *cur->p != '\\') cur->p++;
+            if (out)
+            {
+                size_t run_len = cur->p - run;
+                if (len + run_len > out_size) return false;
+                memcpy(out + len, run, run_len);
+                len += run_len;
+            }
+            if (cur->p >= cur->end) return false;
+
+            char c = *cur->p++;
+            if (c == '"')
+            {
+                if (out_len) *out_len = len;
+                return true;
+            }
+
+            // Escape sequence
+            if (cur->p >= cur->end) return false;
+            c = *cur->p++;
+            bool ok = true;
+            switch (c)
+            {
+                case '"': case '\\': case '/': ok = put(c); break;
+                case 'b': ok = put('\b'); break;
+                case 'f': ok = put('\f'); break;
+                case 'n': ok = put('\n'); break;
+                case 'r': ok = put('\r'); break;
+                case 't': ok = put('\t'); break;
+                case 'u':
+                {
+                    unsigned int code;
+                    if (!read_hex4(cur, &code)) return false;
+                    if (code >= 0xD800 && code <= 0xDBFF)
+                    {
+                        // Surrogate pair
+                        unsigned int low;
+                        if (cur->end - cur->p < 2 || cur->p[0] != '\\' || cur->p[1] != 'u') return false;
+                        cur->p += 2;
+                        if (!read_hex4(cur, &low) || low < 0xDC00 || low > 0xDFFF) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    // Encode as UTF-8
+                    if (code < 0x80)
+                    {
+                        ok = put((char)code);
+                    }
+                    else if (code < 0x800)
+                    {
+                        ok = put((char)(0xC0 | (code >> 6))) && put((char)(0x80 | (code & 0x3F)));
+                    }
+                    else if (code < 0x10000)
+                    {
+                        ok = put((char)(0xE0 | (code >> 12))) &&
+                            put((char)(0x80 | ((code >> 6) & 0x3F))) &&
+                            put((char)(0x80 | (code & 0x3F)));
+                    }
+                    else
+                    {
+                        ok = put((char)(0xF0 | (code >> 18))) &&
+                            put((char)(0x80 | ((code >> 12) & 0x3F))) &&
+                            put((char)(0x80 | ((code >> 6) & 0x3F))) &&
+                            put((char)(0x80 | (code & 0x3F)));
+                    }
+                    break;
+                }
+                default:
+                    return false;
+            }
+            if (!ok) return false;
+        }
+        return false;
+    }
+
+    // Compare key at cursor with "key" and move cursor behind ':'
+    static bool read_key(struct json_cursor* cur, char* key, size_t key_size, size_t* key_len)
+    {
+        if (!read_string(cur, key, key_size, key_len))
+        {
+            // Key longer than buffer is skipped as unknown key
+            return false;
+        }
+        return expect(cur, ':');
+    }
+
+    static bool skip_value(struct json_cursor* cur, int depth=0)
+    {
+        if (depth > 64) return false;
+        skip_whitespace(cur);
+        if (cur->p >= cur->end) return false;
+
+        switch (*cur->p)
+        {
+            case '"':
+                return read_string(cur, NULL, 0, NULL);
+            case '{':
+            {
+                cur->p++;
+                if (peek(cur, '}')) return expect(cur, '}');
+                do
+                {
+                    if (!read_string(cur, NULL, 0, NULL) || !expect(cur, ':')) return false;
+                    if (!skip_value(cur, depth + 1)) return false;
+                } while (expect(cur, ','));
+                return expect(cur, '}');
+            }
+            case '[':
+            {
+                cur->p++;
+                if (peek(cur, ']')) return expect(cur, ']');
+                do
+                {
+                    if (!skip_value(cur, depth + 1)) return false;
+                } while (expect(cur, ','));
+                return expect(cur, ']');
+            }
+            default:
+            {
+                // number, true, false, null
+                const char* start = cur->p;
+                while (cur->p < cur->end && *cur->p != ',' && *cur->p != '}' &&
+                    *cur->p != ']' && *cur->p != ' ' && *cur->p != '\n' &&
+                    *cur->p != '\r' && *cur->p != '\t')
+                {
+                    cur->p++;
+                }
+                return cur->p > start;
+            }
+        }
+    }
+
+    /**
+     * Iterate object members at cursor, calling "on_member" with cursor
+     * placed at member value. Unhandled values must be skipped by "on_member".
+     */
+    template <typename F>
+    static bool for_each_member(struct json_cursor* cur, F on_member)
+    {
+        if (!expect(cur, '{')) return false;
+        if (peek(cur, '}')) return expect(cur, '}');
+        do
+        {
+            char key[16];
+            size_t key_len = 0;
+            struct json_cursor key_start = *cur;
+            if (!read_key(cur, key, sizeof(key), &key_len))
+            {
+                // Long key, which is not interesting
+                *cur = key_start;
+                if (!read_string(cur, NULL, 0, NULL) || !expect(cur, ':')) return false;
+                if (!skip_value(cur)) return false;
+                continue;
+            }
+            if (!on_member(key, key_len)) return false;
+        } while (expect(cur, ','));
+        return expect(cur, '}');
+    }
+
+    static bool key_equals(const char* key, size_t key_len, const char* expected)
+    {
+        return key_len == strlen(expected) && memcmp(key, expected, key_len) == 0;
+    }
+
+    struct json_layers_context
+    {
+        const char* workspace;
+        layer_name_callback on_layer;
+        void* user_data;
+    };
+
+    // {"name":"...","href":"..."}
+    static bool parse_layer_object(struct json_cursor* cur, struct json_layers_context* ctx)
+    {
+        return for_each_member(cur, [cur, ctx](const char* key, size_t key_len) -> bool
+        {
+            if (!key_equals(key, key_len, "name")) return skip_value(cur);
+
+            char name[NAME_MAX];
+            size_t name_len = 0;
+            if (!read_string(cur, name, sizeof(name), &name_len))
+            {
+                fprintf(stderr, "get_layers(): invalid or too long layer name\n");
+                return false;
+            }
+            return emit_layer_name(name, name_len, ctx->workspace, ctx->on_layer,
+                ctx->user_data);
+        });
+    }
+
+    // [{...}, ...] or {...}
+    static bool parse_layer_array(struct json_cursor* cur, struct json_layers_context* ctx)
+    {
+        if (peek(cur, '{')) return parse_layer_object(cur, ctx);
+        if (!expect(cur, '[')) return false;
+        if (peek(cur, ']')) return expect(cur, ']');
+        do
+        {
+            if (!parse_layer_object(cur, ctx)) return false;
+        } while (expect(cur, ','));
+        return expect(cur, ']');
+    }
+
+    bool parse_layers_json(const char* data, size_t len, const char* workspace,
+        layer_name_callback on_layer, void* user_data)
+    {
+        if (!data)
+        {
+            fprintf(stderr, "get_layers() empty JSON response\n");
+            return false;
+        }
+
+        struct json_cursor cur = {data, data + len};
+        struct json_layers_context ctx = {workspace, on_layer, user_data};
+
+        bool status = for_each_member(&cur, [&cur, &ctx](const char* key, size_t key_len) -> bool
+        {
+            if (!key_equals(key, key_len, "layers")) return skip_value(&cur);
+            if (peek(&cur, '"')) return skip_value(&cur); // No layers
+
+            return for_each_member(&cur, [&cur, &ctx](const char* key, size_t key_len) -> bool
+            {
+                if (!key_equals(key, key_len, "layer")) return skip_value(&cur);
+                return parse_layer_array(&cur, &ctx);
+            });
+        });
+
+        if (!status) fprintf(stderr, "get_layers() JSON parsing failed\n");
+        return status;
+    }
+
+} // end: namespace geoserver_api
@@ -0,0 +1,157 @@
+#include <stdio.h>
+
+#include <mutex>
+#include <algorithm>
+#include <condition_variable>
+
+#include "geoserver_curl_wrapper.hpp"
+#include "geoserver_internal.hpp"
+
+namespace geoserver_api
+{
+    // AIMD state, protected by "limiter_mutex"
+    struct limiter_state
+    {
+        struct concurrency_limit policy;
+        double limit = 0; // fractional, slots are floor(limit)
+        int in_flight = 0;
+        uint64_t next_sequence = 0;
+        uint64_t decrease_sequence = 0; // slots acquired before last decrease
+        double baseline_s = 0; // near minimum latency, drifts up slowly
+        double recent_s = 0; // EWMA of latency since last decrease
+        int baseline_samples = 0;
+        int recent_samples = 0;
+        struct concurrency_limit_stats stats;
+    };
+
+    // global variables
+    static std::mutex limiter_mutex;
+    static std::condition_variable limiter_cv;
+    static struct limiter_state limiter;
+
+    static const double BASELINE_DRIFT = 0.001; // weight of slower sample in baseline
+    static const double RECENT_WEIGHT = 0.2;
+    static const double SPIKE_SLACK_S = 0.001; // sub-millisecond noise is not a spike
+
+    void set_concurrency_limit(const struct concurrency_limit& limit)
+    {
+        {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            int in_flight = limiter.in_flight;
+            uint64_t next_sequence = limiter.next_sequence;
+            limiter = limiter_state();
+            limiter.policy = limit;
+            limiter.policy.min_limit = std::max(limit.min_limit, 1);
+            limiter.policy.max_limit = std::max(limit.max_limit, limiter.policy.min_limit);
+            limiter.policy.backoff = std::min(std::max(limit.backoff, 0.0), 1.0);
+            limiter.limit = std::min(std::max(limit.initial_limit, limiter.policy.min_limit),
+                limiter.policy.max_limit);
+            // Requests in progress still return their slots
+            limiter.in_flight = in_flight;
+            limiter.next_sequence = next_sequence;
+            limiter.decrease_sequence = next_sequence;
+        }
+        limiter_cv.notify_all();
+    }
+
+    struct concurrency_limit get_concurrency_limit()
+    {
+        std::lock_guard<std::mutex> lock(limiter_mutex);
+        return limiter.policy;
+    }
+
+    struct concurrency_limit_stats get_concurrency_limit_stats()
+    {
+        std::lock_guard<std::mutex> lock(limiter_mutex);
+        struct concurrency_limit_stats stats = limiter.stats;
+        stats.limit = (limiter.policy.enabled) ? (int)limiter.limit : 0;
+        stats.in_flight = limiter.in_flight;
+        stats.baseline_ms = limiter.baseline_s * 1e3;
+        stats.latency_ms = limiter.recent_s * 1e3;
+        return stats;
+    }
+
+    // Caller must hold "limiter_mutex"
+    static void take_slot(struct limiter_slot* slot)
+    {
+        limiter.in_flight++;
+        slot->acquired = true;
+        slot->sequence = ++limiter.next_sequence;
+    }
+
+    void acquire_limiter_slot(struct limiter_slot* slot)
+    {
+        slot->acquired = false;
+        std::unique_lock<std::mutex> lock(limiter_mutex);
+        limiter_cv.wait(lock, []
+        {
+            return !limiter.policy.enabled || limiter.in_flight < (int)limiter.limit;
+        });
+        if (limiter.policy.enabled) take_slot(slot);
+    }
+
+    bool try_acquire_limiter_slot(struct limiter_slot* slot)
+    {
+        slot->acquired = false;
+        std::lock_guard<std::mutex> lock(limiter_mutex);
+        if (!limiter.policy.enabled) return true;
+        if (limiter.in_flight >= (int)limiter.limit) return false;
+        take_slot(slot);
+        return true;
+    }
+
+    void release_limiter_slot(struct limiter_slot* slot, CURLcode res, long http_code,
+        double latency_s)
+    {
+        if (!slot->acquired) return;
+        slot->acquired = false;
+        {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            limiter.in_flight--;
+            if (!limiter.policy.enabled) return;
+            const struct concurrency_limit& policy = limiter.policy;
+
+            bool overload = (res == CURLE_OK && is_retryable_status(http_code)) ||
+                res == CURLE_OPERATION_TIMEDOUT;
+            bool sample = res == CURLE_OK && !overload;
+            if (sample)
+            {
+                if (!limiter.baseline_samples || latency_s < limiter.baseline_s)
+                {
+                    limiter.baseline_s = latency_s;
+                }
+                else limiter.baseline_s += BASELINE_DRIFT * (latency_s - limiter.baseline_s);
+                limiter.baseline_samples++;
+
+                limiter.recent_s = (limiter.recent_samples) ?
+                    limiter.recent_s + RECENT_WEIGHT * (latency_s - limiter.recent_s) : latency_s;
+                limiter.recent_samples++;
+            }
+            bool spike = sample && limiter.recent_samples >= policy.min_samples &&
+                limiter.recent_s > policy.latency_tolerance * limiter.baseline_s + SPIKE_SLACK_S;
+
+            if (overload) limiter.stats.overloads++;
+            if (overload || spike)
+            {
+                // Requests sent before last decrease saw the old limit
+                if (slot->sequence > limiter.decrease_sequence)
+                {
+                    limiter.limit = std::max(limiter.limit * policy.backoff,
+                        (double)policy.min_limit);
+                    limiter.decrease_sequence = limiter.next_sequence;
+                    limiter.stats.decreases++;
+                    if (spike) limiter.stats.latency_spikes++;
+                    limiter.recent_samples = 0;
+                }
+            }
+            else if (sample && 2 * (limiter.in_flight + 1) >= (int)limiter.limit)
+            {
+                // One more slot per round of requests, only while limit is used
+                limiter.limit = std::min(limiter.limit + 1.0 / limiter.limit,
+                    (double)policy.max_limit);
+            }
+        }
+        limiter_cv.notify_all();
+    }
+
+} // end: namespace geoserver_api
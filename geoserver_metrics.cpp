@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <atomic>
+
+#include "geoserver_metrics.hpp"
+#include "geoserver_internal.hpp"
+
+namespace geoserver_api
+{
+namespace metrics
+{
+    const double bucket_bounds_s[NUM_BUCKETS - 1] = {0.0001, 0.00025, 0.0005, 0.001,
+        0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 10};
+
+    // Same layout as "histogram", sum in microseconds
+    struct atomic_histogram
+    {
+        std::atomic<uint64_t> buckets[NUM_BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum_us;
+    };
+
+    struct atomic_operation_stats
+    {
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> transport_errors;
+        std::atomic<uint64_t> http_errors;
+        std::atomic<uint64_t> retries;
+        std::atomic<uint64_t> hedges;
+        std::atomic<uint64_t> hedge_wins;
+        std::atomic<uint64_t> bytes_up;
+        std::atomic<uint64_t> bytes_down;
+        struct atomic_histogram phases[PHASE_COUNT];
+    };
+
+    // global variables, zero initialized
+    static struct atomic_operation_stats counters[OP_COUNT];
+    static std::atomic<bool> recording{true};
+
+    static const char* const operation_names[OP_COUNT] = {"create_layer",
+        "add_style", "create_layer_group", "get_layers", "upload_file",
+        "update_layer_group", "delete", "get_details"};
+    static const char* const phase_names[PHASE_COUNT] = {"dns", "connect", "tls",
+        "server", "transfer", "total", "queue"};
+
+    static inline void add(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static inline uint64_t load(const std::atomic<uint64_t>& counter)
+    {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    static void observe(struct atomic_histogram* hist, curl_off_t duration_us)
+    {
+        if (duration_us < 0) duration_us = 0;
+        double duration_s = duration_us / 1e6;
+        int bucket = 0;
+        while (bucket < NUM_BUCKETS - 1 && duration_s > bucket_bounds_s[bucket]) bucket++;
+        add(hist->buckets[bucket], 1);
+        add(hist->count, 1);
+        add(hist->sum_us, duration_us);
+    }
+
+    const char* operation_name(const operation op)
+    {
+        return (op >= 0 && op < OP_COUNT) ? operation_names[op] : "unknown";
+    }
+
+    const char* phase_name(const phase ph)
+    {
+        return (ph >= 0 && ph < PHASE_COUNT) ? phase_names[ph] : "unknown";
+    }
+
+    void set_enabled(const bool enabled)
+    {
+        recording = enabled;
+    }
+
+    bool is_enabled()
+    {
+        return recording;
+    }
+
+    static void copy_histogram(const struct atomic_histogram& src, struct histogram* dst)
+    {
+        for (int b = 0; b < NUM_BUCKETS; b++) dst->buckets[b] = load(src.buckets[b]);
+        dst->count = load(src.count);
+        dst->sum_s = load(src.sum_us) / 1e6;
+    }
+
+    struct snapshot get_snapshot()
+    {
+        struct snapshot snap;
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            const struct atomic_operation_stats& src = counters[op];
+            struct operation_stats& dst = snap.operations[op];
+            dst.requests = load(src.requests);
+            dst.transport_errors = load(src.transport_errors);
+            dst.http_errors = load(src.http_errors);
+            dst.retries = load(src.retries);
+            dst.hedges = load(src.hedges);
+            dst.hedge_wins = load(src.hedge_wins);
+            dst.bytes_up = load(src.bytes_up);
+            dst.bytes_down = load(src.bytes_down);
+            for (int ph = 0; ph < PHASE_COUNT; ph++)
+            {
+                copy_histogram(src.phases[ph], &dst.phases[ph]);
+            }
+        }
+        return snap;
+    }
+
+    struct histogram get_histogram(const operation op, const phase ph)
+    {
+        struct histogram hist;
+        if (op < 0 || op >= OP_COUNT || ph < 0 || ph >= PHASE_COUNT) return hist;
+        copy_histogram(counters[op].phases[ph], &hist);
+        return hist;
+    }
+
+    void reset()
+    {
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            struct atomic_operation_stats& stats = counters[op];
+            stats.requests = 0;
+            stats.transport_errors = 0;
+            stats.http_errors = 0;
+            stats.retries = 0;
+            stats.hedges = 0;
+            stats.hedge_wins = 0;
+            stats.bytes_up = 0;
+            stats.bytes_down = 0;
+            for (int ph = 0; ph < PHASE_COUNT; ph++)
+            {
+                for (int b = 0; b < NUM_BUCKETS; b++) stats.phases[ph].buckets[b] = 0;
+                stats.phases[ph].count = 0;
+                stats.phases[ph].sum_us = 0;
+            }
+        }
+    }
+
+    double histogram_quantile(const struct histogram& hist, const double quantile)
+    {
+        if (hist.count == 0) return 0;
+        double rank = quantile * hist.count;
+        uint64_t cumulative = 0;
+        for (int b = 0; b < NUM_BUCKETS; b++)
+        {
+            uint64_t previous = cumulative;
+            cumulative += hist.buckets[b];
+            if (cumulative < rank || hist.buckets[b] == 0) continue;
+            if (b == NUM_BUCKETS - 1) return bucket_bounds_s[NUM_BUCKETS - 2];
+
+            // Linear interpolation inside bucket, as Prometheus does
+            double lower = (b) ? bucket_bounds_s[b - 1] : 0;
+            double upper = bucket_bounds_s[b];
+            return lower + (upper - lower) * (rank - previous) / hist.buckets[b];
+        }
+        return bucket_bounds_s[NUM_BUCKETS - 2];
+    }
+
+    static void append_format(std::string* out, const char* format, ...)
+        __attribute__((format(printf, 2, 3)));
+
+    static void append_format(std::string* out, const char* format, ...)
+    {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int j = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if (j > 0) out->append(line, (j < (int)sizeof(line)) ? j : sizeof(line) - 1);
+    }
+
+    std::string export_prometheus()
+    {
+        struct snapshot snap = get_snapshot();
+        std::string out;
+        out.reserve(16384);
+
+        struct counter_metric
+        {
+            const char* name;
+            const char* help;
+            uint64_t operation_stats::*field;
+        };
+        const struct counter_metric counter_metrics[] = {
+            {"geoserver_requests_total", "Requests sent to Geoserver.",
+                &operation_stats::requests},
+            {"geoserver_transport_errors_total", "Requests failed in libcurl.",
+                &operation_stats::transport_errors},
+            {"geoserver_http_errors_total", "Responses with HTTP status code >= 400.",
+                &operation_stats::http_errors},
+            {"geoserver_retries_total", "Requests repeated by retry policy.",
+                &operation_stats::retries},
+            {"geoserver_hedges_total", "Hedge requests sent.",
+                &operation_stats::hedges},
+            {"geoserver_hedge_wins_total", "Hedge requests answered before primary request.",
+                &operation_stats::hedge_wins},
+            {"geoserver_sent_bytes_total", "Request body bytes sent.",
+                &operation_stats::bytes_up},
+            {"geoserver_received_bytes_total", "Response body bytes received.",
+                &operation_stats::bytes_down},
+        };
+        for (const struct counter_metric& metric : counter_metrics)
+        {
+            append_format(&out, "# HELP %s %s\n# TYPE %s counter\n", metric.name,
+                metric.help, metric.name);
+            for (int op = 0; op < OP_COUNT; op++)
+            {
+                append_format(&out, "%s{operation=\"%s\"} %llu\n", metric.name,
+                    operation_names[op],
+                    (unsigned long long)(snap.operations[op].*metric.field));
+            }
+        }
+
+        const char* name = "geoserver_request_phase_seconds";
+        append_format(&out, "# HELP %s Duration of request phases.\n"
+            "# TYPE %s histogram\n", name, name);
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            for (int ph = 0; ph < PHASE_COUNT; ph++)
+            {
+                const struct histogram& hist = snap.operations[op].phases[ph];
+                uint64_t cumulative = 0;
+                for (int b = 0; b < NUM_BUCKETS; b++)
+                {
+                    cumulative += hist.buckets[b];
+                    char bound[32] = "+Inf";
+                    if (b < NUM_BUCKETS - 1) snprintf(bound, sizeof(bound), "%g", bucket_bounds_s[b]);
+                    append_format(&out, "%s_bucket{operation=\"%s\",phase=\"%s\",le=\"%s\"} %llu\n",
+                        name, operation_names[op], phase_names[ph], bound,
+                        (unsigned long long)cumulative);
+                }
+                append_format(&out, "%s_sum{operation=\"%s\",phase=\"%s\"} %.6f\n",
+                    name, operation_names[op], phase_names[ph], hist.sum_s);
+                append_format(&out, "%s_count{operation=\"%s\",phase=\"%s\"} %llu\n",
+                    name, operation_names[op], phase_names[ph],
+                    (unsigned long long)hist.count);
+            }
+        }
+        return out;
+    }
+
+} // end: namespace metrics
+
+    void record_retry(const metrics::operation op)
+    {
+        if (!metrics::recording.load(std::memory_order_relaxed)) return;
+        if (op < 0 || op >= metrics::OP_COUNT) return;
+        metrics::add(metrics::counters[op].retries, 1);
+    }
+
+    void record_hedge(const metrics::operation op, const bool won)
+    {
+        if (!metrics::recording.load(std::memory_order_relaxed)) return;
+        if (op < 0 || op >= metrics::OP_COUNT) return;
+        metrics::add((won) ? metrics::counters[op].hedge_wins : metrics::counters[op].hedges, 1);
+    }
+
+    void record_queue_wait(const metrics::operation op, const double wait_s)
+    {
+        if (!metrics::recording.load(std::memory_order_relaxed)) return;
+        if (op < 0 || op >= metrics::OP_COUNT) return;
+        metrics::observe(&metrics::counters[op].phases[metrics::PHASE_QUEUE],
+            (curl_off_t)(wait_s * 1e6));
+    }
+
+    void record_request(const metrics::operation op, CURL* handle, CURLcode res,
+        long http_code, struct metrics::request_timing* timing)
+    {
+        using namespace metrics;
+
+        curl_off_t namelookup = 0, connect = 0, pretransfer = 0, ttfb = 0, total = 0;
+        curl_off_t bytes_up = 0, bytes_down = 0;
+        curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+        curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(handle, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+        curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+        curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+        curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &bytes_up);
+        curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes_down);
+
+        if (timing)
+        {
+            timing->namelookup_s = namelookup / 1e6;
+            timing->connect_s = connect / 1e6;
+            timing->pretransfer_s = pretransfer / 1e6;
+            timing->ttfb_s = ttfb / 1e6;
+            timing->total_s = total / 1e6;
+            timing->bytes_up = bytes_up;
+            timing->bytes_down = bytes_down;
+        }
+        if (!recording.load(std::memory_order_relaxed) || op < 0 || op >= OP_COUNT) return;
+
+        struct atomic_operation_stats& stats = counters[op];
+        add(stats.requests, 1);
+        if (res != CURLE_OK) add(stats.transport_errors, 1);
+        else if (http_code >= 400) add(stats.http_errors, 1);
+        add(stats.bytes_up, bytes_up);
+        add(stats.bytes_down, bytes_down);
+
+        // Reused connection and failed transfer leave some times 0
+        if (connect < namelookup) connect = namelookup;
+        if (pretransfer < connect) pretransfer = connect;
+        if (ttfb < pretransfer) ttfb = (total > pretransfer) ? total : pretransfer;
+        observe(&stats.phases[PHASE_DNS], namelookup);
+        observe(&stats.phases[PHASE_CONNECT], connect - namelookup);
+        observe(&stats.phases[PHASE_TLS], pretransfer - connect);
+        observe(&stats.phases[PHASE_SERVER], ttfb - pretransfer);
+        observe(&stats.phases[PHASE_TRANSFER], total - ttfb);
+        observe(&stats.phases[PHASE_TOTAL], total);
+    }
+
+} // end: namespace geoserver_api
@@ -0,0 +1,137 @@
+#ifndef GEOSERVER_METRICS_HPP
+#define GEOSERVER_METRICS_HPP
+
+#include <stdint.h>
+
+#include <string>
+
+/** Request timing instrumentation of "geoserver_curl_wrapper". Every
+ * request (sync and async) records libcurl timing data into per-operation
+ * histograms. Recording is a few relaxed atomic increments, so metrics
+ * are enabled by default.
+ */
+
+namespace geoserver_api
+{
+namespace metrics
+{
+    enum operation
+    {
+        OP_CREATE_LAYER,
+        OP_ADD_STYLE,
+        OP_CREATE_LAYER_GROUP,
+        OP_GET_LAYERS,
+        OP_UPLOAD_FILE,
+        OP_UPDATE_LAYER_GROUP,
+        OP_DELETE, // layers and layer groups
+        OP_GET_DETAILS, // single layer or layer group, layer group lists
+        OP_COUNT
+    };
+
+    /**
+     * @brief Request phases, each histogram holds duration of single phase.
+     * PHASE_SERVER is time from sent request to first response byte,
+     * mostly Geoserver processing. PHASE_QUEUE is not part of PHASE_TOTAL.
+     */
+    enum phase
+    {
+        PHASE_DNS, // name lookup
+        PHASE_CONNECT, // TCP connect, 0 on reused connection
+        PHASE_TLS, // TLS handshake and other pre-transfer work
+        PHASE_SERVER, // waiting for first byte
+        PHASE_TRANSFER, // receiving response
+        PHASE_TOTAL,
+        PHASE_QUEUE, // waiting in async scheduler before sending, async only
+        PHASE_COUNT
+    };
+
+    // Upper bounds of histogram buckets in seconds, last bucket is +Inf
+    const int NUM_BUCKETS = 16;
+    extern const double bucket_bounds_s[NUM_BUCKETS - 1];
+
+    /**
+     * @brief Timing of single request as reported by libcurl. Times are
+     * measured from start of request, like CURLINFO_*_TIME.
+     */
+    struct request_timing
+    {
+        double namelookup_s = 0;
+        double connect_s = 0;
+        double pretransfer_s = 0;
+        double ttfb_s = 0; // CURLINFO_STARTTRANSFER_TIME
+        double total_s = 0;
+        uint64_t bytes_up = 0;
+        uint64_t bytes_down = 0;
+        double queue_s = 0; // waiting in async scheduler, not part of total_s
+    };
+
+    struct histogram
+    {
+        uint64_t buckets[NUM_BUCKETS] = {0}; // not cumulative
+        uint64_t count = 0;
+        double sum_s = 0;
+    };
+
+    struct operation_stats
+    {
+        uint64_t requests = 0;
+        uint64_t transport_errors = 0; // CURL transfer failed
+        uint64_t http_errors = 0; // HTTP status code >= 400
+        uint64_t retries = 0; // requests repeated by retry policy
+        uint64_t hedges = 0; // hedge requests sent
+        uint64_t hedge_wins = 0; // hedge requests answered first
+        uint64_t bytes_up = 0;
+        uint64_t bytes_down = 0;
+        struct histogram phases[PHASE_COUNT];
+    };
+
+    struct snapshot
+    {
+        struct operation_stats operations[OP_COUNT];
+    };
+
+    const char* operation_name(const operation op);
+    const char* phase_name(const phase ph);
+
+    /**
+     * @brief Enable or disable recording, enabled by default
+     */
+    void set_enabled(const bool enabled);
+    bool is_enabled();
+
+    /**
+     * @brief Timing of the last request made by calling thread. Requests
+     * served from catalog cache without network have zero timing.
+     */
+    struct request_timing get_last_request_timing();
+
+    /**
+     * @brief Copy current counters. Counters are updated without lock,
+     * so snapshot taken during requests may be off by requests in progress.
+     */
+    struct snapshot get_snapshot();
+
+    /**
+     * @brief Copy single histogram, cheaper than "get_snapshot()"
+     */
+    struct histogram get_histogram(const operation op, const phase ph);
+
+    /**
+     * @brief Set all counters to zero
+     */
+    void reset();
+
+    /**
+     * @brief Estimate quantile (0..1) from histogram buckets, in seconds
+     */
+    double histogram_quantile(const struct histogram& hist, const double quantile);
+
+    /**
+     * @brief Export counters in Prometheus text format (version 0.0.4)
+     */
+    std::string export_prometheus();
+
+} // end: namespace metrics
+} // end: namespace geoserver_api
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef GEOSERVER_PAYLOAD_HPP
+#define GEOSERVER_PAYLOAD_HPP
+
+#include <string.h>
+
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Builder of request bodies and urls. Payload is described as list of
+ * parts: fixed fragments, which length is known at compile time, and
+ * runtime values, which are XML or url escaped while they are written.
+ * Exact size is computed first, so output is written in single pass
+ * into reusable std::string without size limits.
+ * 
+ * Example:
+ *  payload::build(&out, payload::lit("<name>"), payload::xml{name},
+ *      payload::lit("</name>"));
+ */
+
+namespace geoserver_api
+{
+namespace payload
+{
+    // Fixed fragment, use "lit()" to create it
+    struct literal
+    {
+        const char* text;
+        size_t len;
+    };
+
+    template <size_t N>
+    constexpr struct literal lit(const char (&text)[N])
+    {
+        return literal{text, N - 1};
+    }
+
+    // Runtime value written as it is
+    struct raw
+    {
+        const char* text;
+    };
+
+    // Runtime value escaped for XML text or attribute
+    struct xml
+    {
+        const char* text;
+    };
+
+    // Runtime value percent-encoded as url path segment
+    struct url
+    {
+        const char* text;
+    };
+
+    // Length of escaped XML character, 1 if no escaping is needed
+    inline size_t xml_escaped_len(unsigned char c)
+    {
+        switch (c)
+        {
+            case '&': return 5;  // &amp;
+            case '<': return 4;  // &lt;
+            case '>': return 4;  // &gt;
+            case '"': return 6;  // &quot;
+            case '\'': return 6; // &apos;
+            default: return 1;
+        }
+    }
+
+    inline bool url_unreserved(unsigned char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' || c == '~';
+    }
+
+    inline size_t part_size(const struct literal& part)
+    {
+        return part.len;
+    }
+
+    inline size_t part_size(const struct raw& part)
+    {
+        return (part.text) ? strlen(part.text) : 0;
+    }
+
+    // Characters needing escaping in XML
+    struct xml_escape_table
+    {
+        bool escape[256] = {false};
+
+        constexpr xml_escape_table()
+        {
+            escape['&'] = escape['<'] = escape['>'] = escape['"'] = escape['\''] = true;
+        }
+    };
+    static constexpr xml_escape_table xml_escape{};
+
+    /**
+     * @brief Length of plain run at the beginning of "text", which ends before
+     * first character needing escaping (or at "len").
+     */
+    inline size_t xml_plain_run(const char* text, size_t len)
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        // Compare 16 bytes at once
+        const __m128i amp = _mm_set1_epi8('&');
+        const __m128i lt = _mm_set1_epi8('<');
+        const __m128i gt = _mm_set1_epi8('>');
+        const __m128i quot = _mm_set1_epi8('"');
+        const __m128i apos = _mm_set1_epi8('\'');
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+            __m128i found = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, lt)),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, gt),
+                    _mm_cmpeq_epi8(chunk, quot)), _mm_cmpeq_epi8(chunk, apos)));
+            int mask = _mm_movemask_epi8(found);
+            if (mask) return i + __builtin_ctz(mask);
+        }
+#endif
+        for (; i < len; i++)
+        {
+            if (xml_escape.escape[(unsigned char)text[i]]) return i;
+        }
+        return len;
+    }
+
+    inline size_t part_size(const struct xml& part)
+    {
+        if (!part.text) return 0;
+        size_t len = strlen(part.text);
+        size_t size = len;
+        for (size_t i = xml_plain_run(part.text, len); i < len;
+            i += 1 + xml_plain_run(part.text + i + 1, len - i - 1))
+        {
+            size += xml_escaped_len(part.text[i]) - 1;
+        }
+        return size;
+    }
+
+    inline size_t part_size(const struct url& part)
+    {
+        size_t size = 0;
+        if (!part.text) return 0;
+        for (const unsigned char* c = (const unsigned char*)part.text; *c; c++)
+        {
+            size += (url_unreserved(*c)) ? 1 : 3;
+        }
+        return size;
+    }
+
+    inline char* write_part(char* out, const struct literal& part)
+    {
+        memcpy(out, part.text, part.len);
+        return out + part.len;
+    }
+
+    inline char* write_part(char* out, const struct raw& part)
+    {
+        if (!part.text) return out;
+        size_t len = strlen(part.text);
+        memcpy(out, part.text, len);
+        return out + len;
+    }
+
+    inline char* write_part(char* out, const struct xml& part)
+    {
+        if (!part.text) return out;
+        const char* c = part.text;
+        size_t len = strlen(c);
+        while (true)
+        {
+            // Copy characters without escaping at once
+            size_t run = xml_plain_run(c, len);
+            memcpy(out, c, run);
+            out += run;
+            if (run == len) return out;
+            c += run;
+            len -= run;
+
+            const char* entity;
+            size_t entity_len;
+            switch (*c)
+            {
+                case '&': entity = "&amp;"; entity_len = 5; break;
+                case '<': entity = "&lt;"; entity_len = 4; break;
+                case '>': entity = "&gt;"; entity_len = 4; break;
+                case '"': entity = "&quot;"; entity_len = 6; break;
+                default: entity = "&apos;"; entity_len = 6; break;
+            }
+            memcpy(out, entity, entity_len);
+            out += entity_len;
+            c++;
+            len--;
+        }
+    }
+
+    inline char* write_part(char* out, const struct url& part)
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        if (!part.text) return out;
+        for (const unsigned char* c = (const unsigned char*)part.text; *c; c++)
+        {
+            if (url_unreserved(*c))
+            {
+                *out++ = *c;
+                continue;
+            }
+            *out++ = '%';
+            *out++ = hex[*c >> 4];
+            *out++ = hex[*c & 0x0F];
+        }
+        return out;
+    }
+
+    /**
+     * @brief Replace content of "out" with concatenated parts.
+     * Capacity of "out" is reused.
+     */
+    template <typename... Parts>
+    inline void build(std::string* out, const Parts&... parts)
+    {
+        size_t size = (part_size(parts) + ... + 0);
+        out->resize(size);
+        char* p = &(*out)[0];
+        ((p = write_part(p, parts)), ...);
+    }
+
+    /**
+     * @brief Append concatenated parts at the end of "out". Capacity grows
+     * geometrically, so repeated appends take linear time.
+     */
+    template <typename... Parts>
+    inline void append(std::string* out, const Parts&... parts)
+    {
+        size_t offset = out->size();
+        size_t size = (part_size(parts) + ... + 0);
+        out->resize(offset + size);
+        char* p = &(*out)[offset];
+        ((p = write_part(p, parts)), ...);
+    }
+
+} // end: namespace payload
+} // end: namespace geoserver_api
+
+#endif
@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <set>
+#include <chrono>
+#include <future>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "geoserver_reconcile.hpp"
+#include "geoserver_async.hpp"
+
+namespace geoserver_api
+{
+namespace reconcile
+{
+    typedef std::chrono::steady_clock reconcile_clock;
+
+    static double elapsed_ms(reconcile_clock::time_point from, reconcile_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    static bool is_success(const async::response& resp)
+    {
+        return resp.success && resp.http_code >= 200 && resp.http_code < 300;
+    }
+
+    // Split "{workspace}:{name}"
+    static void split_key(const std::string& key, std::string* workspace, std::string* name)
+    {
+        size_t colon = key.find(':');
+        *workspace = key.substr(0, colon);
+        *name = (colon == std::string::npos) ? "" : key.substr(colon + 1);
+    }
+
+    static xmlNodePtr find_child(xmlNodePtr parent, const char* name)
+    {
+        if (!parent) return NULL;
+        for (xmlNodePtr node = parent->children; node; node = node->next)
+        {
+            if (node->type == XML_ELEMENT_NODE && strcmp((const char*)node->name, name) == 0)
+            {
+                return node;
+            }
+        }
+        return NULL;
+    }
+
+    static std::string node_text(xmlNodePtr node)
+    {
+        if (!node) return "";
+        char* content = (char*)xmlNodeGetContent(node);
+        if (!content) return "";
+        std::string text = content;
+        xmlFree(content);
+        return text;
+    }
+
+    // Style name with workspace, Geoserver may report workspace in own element
+    static std::string qualified_style(xmlNodePtr style)
+    {
+        std::string name = node_text(find_child(style, "name"));
+        std::string workspace = node_text(find_child(style, "workspace"));
+        if (!name.empty() && !workspace.empty() && name.find(':') == std::string::npos)
+        {
+            return workspace + ":" + name;
+        }
+        return name;
+    }
+
+    /**
+     * Compare layer document with style of "spec". Returns reason of
+     * update or empty string if layer is in desired state.
+     */
+    static std::string layer_drift(const std::string& document, const batch::style_spec& spec)
+    {
+        xmlDocPtr doc = xmlReadMemory(document.data(), document.size(), NULL, NULL, 0);
+        if (!doc) return "unreadable layer";
+        std::string current = qualified_style(
+            find_child(xmlDocGetRootElement(doc), "defaultStyle"));
+        xmlFreeDoc(doc);
+
+        // Global style has no workspace prefix, same as "qualified_style()"
+        std::string desired = spec.style_name;
+        if (!spec.style_workspace.empty() && desired.find(':') == std::string::npos)
+        {
+            desired = spec.style_workspace + ":" + desired;
+        }
+        if (current == desired) return "";
+        return "style " + ((current.empty()) ? std::string("none") : current) +
+            " -> " + desired;
+    }
+
+    /**
+     * Compare layer group document with "spec", groups of manifest use
+     * default styles of their layers.
+     */
+    static std::string group_drift(const std::string& document, const batch::group_spec& spec)
+    {
+        xmlDocPtr doc = xmlReadMemory(document.data(), document.size(), NULL, NULL, 0);
+        if (!doc) return "unreadable layer group";
+        xmlNodePtr root = xmlDocGetRootElement(doc);
+
+        std::string reason;
+        if (node_text(find_child(root, "title")) != spec.layer_title) reason = "title";
+
+        std::vector<std::string> layers;
+        xmlNodePtr publishables = find_child(root, "publishables");
+        for (xmlNodePtr node = (publishables) ? publishables->children : NULL; node;
+            node = node->next)
+        {
+            if (node->type != XML_ELEMENT_NODE) continue;
+            layers.push_back(node_text(find_child(node, "name")));
+        }
+        bool same_layers = layers.size() == spec.layer_names.size();
+        for (size_t i = 0; same_layers && i < layers.size(); i++)
+        {
+            same_layers = layers[i] == spec.workspace + ":" + spec.layer_names[i];
+        }
+        if (!same_layers) reason += (reason.empty()) ? "layers" : ", layers";
+
+        xmlNodePtr styles = find_child(root, "styles");
+        for (xmlNodePtr node = (styles) ? styles->children : NULL; node; node = node->next)
+        {
+            if (node->type != XML_ELEMENT_NODE || qualified_style(node).empty()) continue;
+            reason += (reason.empty()) ? "styles" : ", styles";
+            break;
+        }
+        xmlFreeDoc(doc);
+        return reason;
+    }
+
+    static void add_action(struct report* rep, action_type type, resource_type resource,
+        const std::string& name, const char* reason)
+    {
+        struct action act;
+        act.type = type;
+        act.resource = resource;
+        act.name = name;
+        act.reason = reason;
+        rep->actions.push_back(act);
+    }
+
+    static void store_response(struct action* act, const async::response& resp)
+    {
+        act->success = is_success(resp);
+        act->http_code = resp.http_code;
+        act->duration_ms = resp.timing.total_s * 1e3;
+    }
+
+    /**
+     * Read catalog and fill "rep" with actions. Creates and style updates
+     * are collected in "writes" for "batch::provision()", "write_actions"
+     * maps its items (layers, styles, groups) to actions.
+     */
+    static bool plan(const batch::manifest& desired, const options& opts,
+        struct report* rep, batch::manifest* writes, std::vector<size_t>* write_actions)
+    {
+        // Layers of all workspaces in single request
+        std::set<std::string> existing_layers;
+        struct layer_list current;
+        bool read = get_layers(NULL, &current);
+        rep->catalog_reads++;
+        for (size_t i = 0; read && i < current.size(); i++) existing_layers.insert(current[i]);
+        free_layer_list(&current);
+        if (!read)
+        {
+            fprintf(stderr, "reconcile::run(): get_layers() failed\n");
+            return false;
+        }
+
+        // Layer groups are listed per workspace, only where they matter
+        std::set<std::string> group_workspaces(opts.prune_workspaces.begin(),
+            opts.prune_workspaces.end());
+        for (const batch::group_spec& spec : desired.groups)
+        {
+            group_workspaces.insert(spec.workspace);
+        }
+        std::vector<std::future<async::response>> group_lists;
+        for (const std::string& workspace : group_workspaces)
+        {
+            group_lists.push_back(async::get_layer_groups(workspace.c_str()));
+        }
+        std::set<std::string> existing_groups;
+        bool groups_read = true;
+        for (std::future<async::response>& future : group_lists)
+        {
+            async::response resp = future.get();
+            rep->catalog_reads++;
+            if (resp.success && resp.http_code == 404) continue; // no workspace yet
+            if (!is_success(resp))
+            {
+                fprintf(stderr, "reconcile::run(): layer group list failed, HTTP %ld\n",
+                    resp.http_code);
+                groups_read = false;
+                continue;
+            }
+            existing_groups.insert(resp.layer_names.begin(), resp.layer_names.end());
+        }
+        if (!groups_read) return false;
+
+        // Optional verification of existing resources, all reads in parallel
+        std::map<size_t, std::future<async::response>> style_reads, group_reads;
+        std::set<std::string> desired_layers;
+        for (const batch::layer_spec& spec : desired.layers)
+        {
+            desired_layers.insert(spec.workspace + ":" + spec.layer_name);
+        }
+        std::vector<const char*> style_reasons(desired.styles.size(), NULL);
+        for (size_t i = 0; i < desired.styles.size(); i++)
+        {
+            const batch::style_spec& spec = desired.styles[i];
+            std::string layer = spec.layer_workspace + ":" + spec.layer_name;
+            if (!existing_layers.count(layer)) style_reasons[i] = "new layer";
+            else if (opts.verify_existing)
+            {
+                style_reads[i] = async::get_layer_details(spec.layer_name.c_str(),
+                    spec.layer_workspace.c_str());
+            }
+        }
+        for (size_t i = 0; opts.verify_existing && i < desired.groups.size(); i++)
+        {
+            const batch::group_spec& spec = desired.groups[i];
+            if (!existing_groups.count(spec.workspace + ":" + spec.layer_group_name)) continue;
+            group_reads[i] = async::get_layer_group_details(spec.layer_group_name.c_str(),
+                spec.workspace.c_str());
+        }
+
+        // Layer group deletes first, they may hold layers deleted later.
+        // Only pruned workspaces, other groups are listed to detect creates.
+        std::set<std::string> pruned(opts.prune_workspaces.begin(), opts.prune_workspaces.end());
+        for (const std::string& group : existing_groups)
+        {
+            std::string workspace, name;
+            split_key(group, &workspace, &name);
+            if (!pruned.count(workspace)) continue;
+            bool listed = false;
+            for (const batch::group_spec& spec : desired.groups)
+            {
+                listed = listed || (spec.workspace == workspace && spec.layer_group_name == name);
+            }
+            if (!listed) add_action(rep, ACTION_DELETE, RESOURCE_GROUP, group, "not in manifest");
+        }
+
+        // Creates and style updates, executed together by "batch::provision()"
+        for (const batch::layer_spec& spec : desired.layers)
+        {
+            std::string layer = spec.workspace + ":" + spec.layer_name;
+            if (existing_layers.count(layer))
+            {
+                rep->unchanged++;
+                continue;
+            }
+            write_actions->push_back(rep->actions.size());
+            writes->layers.push_back(spec);
+            add_action(rep, ACTION_CREATE, RESOURCE_LAYER, layer, "missing");
+        }
+        for (size_t i = 0; i < desired.styles.size(); i++)
+        {
+            const batch::style_spec& spec = desired.styles[i];
+            std::string layer = spec.layer_workspace + ":" + spec.layer_name;
+            std::string reason = (style_reasons[i]) ? style_reasons[i] : "";
+            auto read_it = style_reads.find(i);
+            if (read_it != style_reads.end())
+            {
+                async::response resp = read_it->second.get();
+                rep->detail_reads++;
+                if (!is_success(resp))
+                {
+                    // Unknown state is not drift, leave layer unchanged
+                    fprintf(stderr, "reconcile::run(): read of layer %s failed, HTTP %ld\n",
+                        layer.c_str(), resp.http_code);
+                    rep->failed_reads++;
+                    continue;
+                }
+                reason = layer_drift(resp.body, spec);
+            }
+            if (reason.empty())
+            {
+                rep->unchanged++;
+                continue;
+            }
+            write_actions->push_back(rep->actions.size());
+            writes->styles.push_back(spec);
+            add_action(rep, (style_reasons[i]) ? ACTION_CREATE : ACTION_UPDATE,
+                RESOURCE_STYLE, layer, reason.c_str());
+        }
+        for (size_t i = 0; i < desired.groups.size(); i++)
+        {
+            const batch::group_spec& spec = desired.groups[i];
+            std::string group = spec.workspace + ":" + spec.layer_group_name;
+            auto read_it = group_reads.find(i);
+            if (read_it != group_reads.end())
+            {
+                async::response resp = read_it->second.get();
+                rep->detail_reads++;
+                if (!is_success(resp))
+                {
+                    fprintf(stderr, "reconcile::run(): read of layer group %s failed, "
+                        "HTTP %ld\n", group.c_str(), resp.http_code);
+                    rep->failed_reads++;
+                    continue;
+                }
+                std::string reason = group_drift(resp.body, spec);
+                if (reason.empty()) rep->unchanged++;
+                else add_action(rep, ACTION_UPDATE, RESOURCE_GROUP, group, reason.c_str());
+                continue;
+            }
+            if (existing_groups.count(group))
+            {
+                rep->unchanged++;
+                continue;
+            }
+            write_actions->push_back(rep->actions.size());
+            writes->groups.push_back(spec);
+            add_action(rep, ACTION_CREATE, RESOURCE_GROUP, group, "missing");
+        }
+
+        // Layer deletes last, after layer groups stopped using them
+        for (const std::string& workspace : opts.prune_workspaces)
+        {
+            std::string prefix = workspace + ":";
+            for (auto it = existing_layers.lower_bound(prefix);
+                it != existing_layers.end() && it->compare(0, prefix.size(), prefix) == 0; ++it)
+            {
+                if (desired_layers.count(*it)) continue;
+                add_action(rep, ACTION_DELETE, RESOURCE_LAYER, *it, "not in manifest");
+            }
+        }
+        return true;
+    }
+
+    // Send actions of one phase in parallel and wait for all of them
+    static void execute_phase(struct report* rep, const batch::manifest& desired,
+        const options& opts, action_type type, resource_type resource)
+    {
+        std::vector<std::pair<size_t, std::future<async::response>>> pending;
+        for (size_t i = 0; i < rep->actions.size(); i++)
+        {
+            const struct action& act = rep->actions[i];
+            if (act.type != type || act.resource != resource) continue;
+            std::string workspace, name;
+            split_key(act.name, &workspace, &name);
+
+            if (type == ACTION_DELETE && resource == RESOURCE_GROUP)
+            {
+                pending.emplace_back(i, async::delete_layer_group(name.c_str(),
+                    workspace.c_str()));
+            }
+            else if (type == ACTION_DELETE && resource == RESOURCE_LAYER)
+            {
+                pending.emplace_back(i, async::delete_layer(name.c_str(), workspace.c_str(),
+                    opts.prune_datastore.c_str()));
+            }
+            else if (type == ACTION_UPDATE && resource == RESOURCE_GROUP)
+            {
+                for (const batch::group_spec& spec : desired.groups)
+                {
+                    if (spec.workspace != workspace || spec.layer_group_name != name) continue;
+                    layer_group_builder layers;
+                    for (const std::string& layer : spec.layer_names)
+                    {
+                        layers.add(spec.workspace.c_str(), layer.c_str());
+                    }
+                    pending.emplace_back(i, async::update_layer_group(name.c_str(),
+                        spec.layer_title.c_str(), layers, workspace.c_str(), spec.advertised));
+                    break;
+                }
+            }
+        }
+        for (auto& item : pending)
+        {
+            store_response(&rep->actions[item.first], item.second.get());
+        }
+    }
+
+    report run(const batch::manifest& desired, const options& opts)
+    {
+        reconcile_clock::time_point start = reconcile_clock::now();
+        report rep;
+        rep.dry_run = opts.dry_run;
+        async::priority_scope scope(async::PRIORITY_BULK);
+
+        if (!async::acquire())
+        {
+            fprintf(stderr, "reconcile::run(): async::acquire() failed\n");
+            return rep;
+        }
+
+        batch::manifest writes;
+        std::vector<size_t> write_actions;
+        bool planned = plan(desired, opts, &rep, &writes, &write_actions);
+        rep.plan_ms = elapsed_ms(start, reconcile_clock::now());
+        if (!planned || opts.dry_run)
+        {
+            async::release();
+            rep.success = planned && rep.failed_reads == 0;
+            rep.total_ms = elapsed_ms(start, reconcile_clock::now());
+            return rep;
+        }
+
+        execute_phase(&rep, desired, opts, ACTION_DELETE, RESOURCE_GROUP);
+        if (!write_actions.empty())
+        {
+            batch::result created = batch::provision(writes);
+            for (size_t i = 0; i < created.items.size() && i < write_actions.size(); i++)
+            {
+                const batch::item_result& item = created.items[i];
+                struct action& act = rep.actions[write_actions[i]];
+                act.success = item.success;
+                act.skipped = item.skipped;
+                act.http_code = item.http_code;
+                act.duration_ms = item.duration_ms;
+            }
+        }
+        execute_phase(&rep, desired, opts, ACTION_UPDATE, RESOURCE_GROUP);
+        execute_phase(&rep, desired, opts, ACTION_DELETE, RESOURCE_LAYER);
+        async::release();
+
+        rep.success = rep.failed_reads == 0;
+        for (const struct action& act : rep.actions)
+        {
+            if (!act.success) rep.success = false;
+        }
+        rep.total_ms = elapsed_ms(start, reconcile_clock::now());
+        return rep;
+    }
+
+    void print_report(const report& result, FILE* out)
+    {
+        static const char* const type_names[] = {"create", "update", "delete"};
+        static const char* const resource_names[] = {"layer", "style", "group"};
+
+        size_t counts[3] = {0};
+        fprintf(out, "%-7s %-6s %-40s %-8s %5s %9s  %s\n", "action", "kind", "name",
+            "result", "http", "ms", "reason");
+        for (const struct action& act : result.actions)
+        {
+            counts[act.type]++;
+            const char* status = (result.dry_run) ? "planned" :
+                (act.skipped) ? "skipped" : (act.success) ? "ok" : "failed";
+            fprintf(out, "%-7s %-6s %-40s %-8s %5ld %9.2f  %s\n", type_names[act.type],
+                resource_names[act.resource], act.name.c_str(), status, act.http_code,
+                act.duration_ms, act.reason.c_str());
+        }
+        fprintf(out, "%s: %zu create, %zu update, %zu delete, %zu unchanged; "
+            "%zu catalog reads, %zu detail reads (%zu failed); plan %.1f ms, total %.1f ms\n",
+            (result.dry_run) ? "dry run" : (result.success) ? "deployed" : "failed",
+            counts[ACTION_CREATE], counts[ACTION_UPDATE], counts[ACTION_DELETE],
+            result.unchanged, result.catalog_reads, result.detail_reads, result.failed_reads,
+            result.plan_ms, result.total_ms);
+    }
+
+} // end: namespace reconcile
+} // end: namespace geoserver_api
@@ -0,0 +1,104 @@
+#ifndef GEOSERVER_RECONCILE_HPP
+#define GEOSERVER_RECONCILE_HPP
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "geoserver_batch.hpp"
+
+/** Declarative deployment of layers, styles and layer groups. Desired
+ * state is described by "batch::manifest", current catalog is read once
+ * and only the difference is written: missing resources are created,
+ * drifted ones updated and (optionally) resources missing in manifest
+ * deleted. Writes run in parallel with "geoserver_async.hpp" engine, so
+ * deploying unchanged manifest costs catalog reads instead of N writes.
+ */
+
+namespace geoserver_api
+{
+namespace reconcile
+{
+    enum action_type
+    {
+        ACTION_CREATE,
+        ACTION_UPDATE,
+        ACTION_DELETE
+    };
+
+    enum resource_type
+    {
+        RESOURCE_LAYER,
+        RESOURCE_STYLE, // default style of layer
+        RESOURCE_GROUP
+    };
+
+    /**
+     * @brief Single write planned (and, unless dry run, executed)
+     */
+    struct action
+    {
+        action_type type;
+        resource_type resource;
+        std::string name; // {workspace}:{name}, layer name for styles
+        std::string reason; // why action is needed, e.g. "missing"
+        bool success = false; // transfer succeeded and HTTP status code is 2xx
+        bool skipped = false; // not sent, because dependency failed
+        long http_code = 0;
+        double duration_ms = 0;
+    };
+
+    struct options
+    {
+        bool dry_run = false; // only plan actions, nothing is written
+        // Read default style of existing layers and content of existing layer
+        // groups and update drifted ones. Costs one GET per existing resource,
+        // without it existing resources are trusted by name.
+        bool verify_existing = false;
+        // Delete layers and layer groups of these workspaces missing in manifest,
+        // nothing is deleted if empty
+        std::vector<std::string> prune_workspaces;
+        std::string prune_datastore = "postgis"; // datastore of pruned layers
+    };
+
+    struct report
+    {
+        std::vector<action> actions; // in execution order
+        size_t unchanged = 0; // manifest items already in desired state
+        size_t catalog_reads = 0; // layer list and layer group lists
+        size_t detail_reads = 0; // single resource reads of "verify_existing"
+        // Failed detail reads, their resources are left unchanged
+        size_t failed_reads = 0;
+        bool dry_run = false;
+        // catalog was read, all detail reads and actions succeeded
+        bool success = false;
+        double plan_ms = 0; // reading catalog and computing difference
+        double total_ms = 0;
+    };
+
+    /**
+     * @brief Bring catalog to state of "desired". Holds async engine
+     * with "async::acquire()", see "batch::provision()". Blocks until all
+     * actions are done. Actions run in phases: layer group deletes,
+     * creates and style updates (see "batch::provision()"), layer group
+     * updates and layer deletes, so layers are never deleted while
+     * layer group of manifest still uses them. Async requests are sent
+     * in "async::PRIORITY_BULK" class.
+     *
+     * @param desired layers, styles and layer groups which should exist
+     * @param opts dry run, verification and pruning
+     *
+     * @returns planned actions with their results
+     */
+    report run(const batch::manifest& desired, const options& opts=options());
+
+    /**
+     * @brief Print action table and summary of "result"
+     */
+    void print_report(const report& result, FILE* out=stdout);
+
+} // end: namespace reconcile
+} // end: namespace geoserver_api
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <mutex>
+#include <random>
+#include <algorithm>
+
+#include "geoserver_curl_wrapper.hpp"
+#include "geoserver_internal.hpp"
+
+namespace geoserver_api
+{
+    // global variables
+    static std::mutex policy_mutex;
+    static struct retry_policy current_retry_policy;
+    static struct hedge_policy current_hedge_policy;
+
+    void set_retry_policy(const struct retry_policy& policy)
+    {
+        std::lock_guard<std::mutex> lock(policy_mutex);
+        current_retry_policy = policy;
+        if (current_retry_policy.max_attempts < 1) current_retry_policy.max_attempts = 1;
+        current_retry_policy.jitter = std::min(std::max(policy.jitter, 0.0), 1.0);
+    }
+
+    struct retry_policy get_retry_policy()
+    {
+        std::lock_guard<std::mutex> lock(policy_mutex);
+        return current_retry_policy;
+    }
+
+    void set_hedge_policy(const struct hedge_policy& policy)
+    {
+        std::lock_guard<std::mutex> lock(policy_mutex);
+        current_hedge_policy = policy;
+    }
+
+    struct hedge_policy get_hedge_policy()
+    {
+        std::lock_guard<std::mutex> lock(policy_mutex);
+        return current_hedge_policy;
+    }
+
+    bool is_retryable_status(long http_code)
+    {
+        return http_code == 429 || http_code == 503;
+    }
+
+    bool is_retryable(const struct http_request& request, CURLcode res, long http_code)
+    {
+        if (strcmp(request.method, "POST") == 0) return false; // not idempotent
+
+        switch (res)
+        {
+            case CURLE_OK:
+                return is_retryable_status(http_code);
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+            case CURLE_HTTP2_STREAM:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    long retry_delay_ms(const struct retry_policy& policy, int attempt,
+        curl_off_t retry_after_s)
+    {
+        // Exponential backoff: base, 2 * base, 4 * base, ...
+        double delay = policy.base_delay_ms * pow(2.0, std::min(attempt - 1, 30));
+        delay = std::min(delay, (double)policy.max_delay_ms);
+
+        static thread_local std::mt19937 generator(std::random_device{}());
+        double random = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+        delay -= delay * policy.jitter * random;
+
+        if (policy.respect_retry_after && retry_after_s > 0)
+        {
+            delay = std::max(delay, std::min((double)retry_after_s * 1000,
+                (double)policy.max_delay_ms));
+        }
+        return (long)delay;
+    }
+
+    long hedge_delay_ms(const struct hedge_policy& policy, const metrics::operation op)
+    {
+        struct metrics::histogram latency = metrics::get_histogram(op, metrics::PHASE_TOTAL);
+        if (latency.count < (uint64_t)std::max(policy.min_samples, 1))
+        {
+            return policy.initial_delay_ms;
+        }
+        long delay = (long)(metrics::histogram_quantile(latency, policy.percentile) * 1000);
+        return std::min(std::max(delay, policy.min_delay_ms), policy.max_delay_ms);
+    }
+
+} // end: namespace geoserver_api
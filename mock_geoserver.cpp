@@ -0,0 +1,732 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+
+#include <chrono>
+#include <algorithm>
+#include <random>
+
+#include "mock_geoserver.hpp"
+
+namespace geoserver_mock
+{
+    static const char rest_prefix[] = "/geoserver/rest/";
+
+    // Random number in [0, 1)
+    static double random_unit()
+    {
+        static thread_local std::mt19937 generator(std::random_device{}());
+        return std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+    }
+
+    static std::string lowercase(std::string text)
+    {
+        for (char& c : text) c = tolower((unsigned char)c);
+        return text;
+    }
+
+    // Compress ("compress" true) or decompress gzip data
+    static bool gzip_transform(const std::string& in, std::string* out, bool compress)
+    {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        int res = (compress) ?
+            deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                Z_DEFAULT_STRATEGY) :
+            inflateInit2(&stream, 15 + 16);
+        if (res != Z_OK) return false;
+
+        stream.next_in = (Bytef*)in.data();
+        stream.avail_in = in.size();
+        out->clear();
+        char chunk[65536];
+        do
+        {
+            stream.next_out = (Bytef*)chunk;
+            stream.avail_out = sizeof(chunk);
+            res = (compress) ? deflate(&stream, Z_FINISH) : inflate(&stream, Z_NO_FLUSH);
+            out->append(chunk, sizeof(chunk) - stream.avail_out);
+        } while (res == Z_OK);
+
+        if (compress) deflateEnd(&stream);
+        else inflateEnd(&stream);
+        return res == Z_STREAM_END;
+    }
+
+    // Content of first <tag> element in XML body after "from"
+    static std::string xml_text(const std::string& body, const std::string& tag,
+        size_t from = 0)
+    {
+        std::string open = "<" + tag + ">";
+        size_t start = body.find(open, from);
+        if (start == std::string::npos) return "";
+        start += open.size();
+        size_t end = body.find("</" + tag + ">", start);
+        if (end == std::string::npos) return "";
+        return body.substr(start, end - start);
+    }
+
+    // Content of first <name> element in XML body
+    static std::string xml_name(const std::string& body)
+    {
+        return xml_text(body, "name");
+    }
+
+    // Names of <published> layers and their <style> names from layer group body
+    static bool parse_group(const std::string& body, std::vector<std::string>* layers,
+        std::vector<std::string>* styles)
+    {
+        for (size_t pos = body.find("<published"); pos != std::string::npos;
+            pos = body.find("<published", pos + 1))
+        {
+            std::string name = xml_name(body.substr(pos, body.find("</published>", pos) - pos));
+            if (name.empty()) return false;
+            layers->push_back(name);
+        }
+        size_t end = body.find("</styles>");
+        for (size_t pos = body.find("<style"); pos != std::string::npos && pos < end;
+            pos = body.find("<style", pos + 1))
+        {
+            if (body.compare(pos, 7, "<styles") == 0) continue;
+            bool empty = body.compare(pos, 8, "<style/>") == 0;
+            styles->push_back((empty) ? "" :
+                xml_name(body.substr(pos, body.find("</style>", pos) - pos)));
+        }
+        if (styles->empty()) styles->resize(layers->size());
+        return !layers->empty() && styles->size() == layers->size();
+    }
+
+    static std::string url_decode(const std::string& text)
+    {
+        std::string out;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '%' && i + 2 < text.size())
+            {
+                out += (char)strtol(text.substr(i + 1, 2).c_str(), NULL, 16);
+                i += 2;
+            }
+            else
+            {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+
+    // Split path into segments separated by '/'
+    static std::vector<std::string> split_path(const std::string& path)
+    {
+        std::vector<std::string> segments;
+        size_t start = 0;
+        while (start <= path.size())
+        {
+            size_t end = path.find('/', start);
+            if (end == std::string::npos) end = path.size();
+            segments.push_back(url_decode(path.substr(start, end - start)));
+            start = end + 1;
+        }
+        return segments;
+    }
+
+    static bool ends_with(const std::string& text, const char* suffix)
+    {
+        size_t len = strlen(suffix);
+        return text.size() >= len && text.compare(text.size() - len, len, suffix) == 0;
+    }
+
+    mock_server::~mock_server()
+    {
+        stop();
+    }
+
+    bool mock_server::start(const mock_options& opts)
+    {
+        if (running) return false;
+        options = opts;
+
+        // Initial catalog
+        layers.clear();
+        layer_keys.clear();
+        groups.clear();
+        for (int i = 0; i < options.num_layers; i++)
+        {
+            catalog_layer layer;
+            layer.workspace = "workspace" + std::to_string(i % std::max(options.num_workspaces, 1));
+            layer.name = "layer_" + std::to_string(i);
+            layer_keys.insert(layer.workspace + ":" + layer.name);
+            layers.push_back(layer);
+        }
+        catalog_version++;
+        counters = mock_stats();
+
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0)
+        {
+            perror("mock_server socket()");
+            return false;
+        }
+        int yes = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(options.port);
+        if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            listen(listen_fd, 512) != 0)
+        {
+            perror("mock_server bind()/listen()");
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+
+        socklen_t addr_len = sizeof(addr);
+        getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len);
+        listen_port = ntohs(addr.sin_port);
+
+        running = true;
+        accept_thread = std::thread(&mock_server::accept_loop, this);
+        return true;
+    }
+
+    void mock_server::stop()
+    {
+        if (!running) return;
+        running = false;
+
+        shutdown(listen_fd, SHUT_RDWR);
+        close(listen_fd);
+        listen_fd = -1;
+        accept_thread.join();
+
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            for (int fd : connection_fds) shutdown(fd, SHUT_RDWR);
+            threads.swap(connection_threads);
+        }
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    int mock_server::port() const
+    {
+        return listen_port;
+    }
+
+    mock_stats mock_server::stats()
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        return counters;
+    }
+
+    void mock_server::accept_loop()
+    {
+        while (running)
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd < 0)
+            {
+                if (!running) break;
+                continue;
+            }
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                counters.connections++;
+            }
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            connection_fds.push_back(fd);
+            connection_threads.emplace_back(&mock_server::serve_connection, this, fd);
+        }
+    }
+
+    bool mock_server::send_all(int fd, const char* data, size_t len)
+    {
+        {
+            // Counted up front, so client sees it as soon as response arrives
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            counters.bytes_sent += len;
+        }
+
+        // Limited bandwidth is simulated by sending in paced chunks
+        size_t max_chunk = (options.bandwidth_mbit > 0) ? 16384 : len;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t sent = 0;
+        while (sent < len)
+        {
+            ssize_t n = send(fd, data + sent, std::min(len - sent, max_chunk), MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += n;
+            if (options.bandwidth_mbit > 0)
+            {
+                std::this_thread::sleep_until(start + std::chrono::microseconds(
+                    (long long)sent * 8 / options.bandwidth_mbit));
+            }
+        }
+        return true;
+    }
+
+    void mock_server::serve_connection(int fd)
+    {
+        std::string buffer;
+        char chunk[16384];
+        bool keep_alive = true;
+
+        while (keep_alive && running)
+        {
+            // Read request head
+            size_t head_end;
+            while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) goto end;
+                buffer.append(chunk, n);
+            }
+
+            std::string head = buffer.substr(0, head_end);
+            buffer.erase(0, head_end + 4);
+
+            size_t line_end = head.find("\r\n");
+            std::string request_line = head.substr(0, line_end);
+            size_t sp1 = request_line.find(' ');
+            size_t sp2 = request_line.find(' ', sp1 + 1);
+            if (sp1 == std::string::npos || sp2 == std::string::npos) break;
+            std::string method = request_line.substr(0, sp1);
+            std::string path = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+            std::map<std::string, std::string> headers;
+            size_t pos = (line_end == std::string::npos) ? head.size() : line_end + 2;
+            while (pos < head.size())
+            {
+                size_t end = head.find("\r\n", pos);
+                if (end == std::string::npos) end = head.size();
+                std::string line = head.substr(pos, end - pos);
+                size_t colon = line.find(':');
+                if (colon != std::string::npos)
+                {
+                    size_t value_start = line.find_first_not_of(' ', colon + 1);
+                    headers[lowercase(line.substr(0, colon))] =
+                        (value_start == std::string::npos) ? "" : line.substr(value_start);
+                }
+                pos = end + 2;
+            }
+
+            // Read body
+            size_t content_length = 0;
+            if (headers.count("content-length"))
+            {
+                content_length = strtoul(headers["content-length"].c_str(), NULL, 10);
+            }
+            if (content_length && lowercase(headers["expect"]) == "100-continue")
+            {
+                const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                if (!send_all(fd, cont, sizeof(cont) - 1)) break;
+            }
+            std::string body;
+            if (path.find("/file.") != std::string::npos)
+            {
+                // Uploaded files are only counted, not stored
+                size_t remaining = content_length - std::min(content_length, buffer.size());
+                buffer.erase(0, std::min(content_length, buffer.size()));
+                while (remaining > 0)
+                {
+                    ssize_t n = recv(fd, chunk, std::min(sizeof(chunk), remaining), 0);
+                    if (n <= 0) goto end;
+                    remaining -= n;
+                }
+            }
+            else
+            {
+                while (buffer.size() < content_length)
+                {
+                    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                    if (n <= 0) goto end;
+                    buffer.append(chunk, n);
+                }
+                body = buffer.substr(0, content_length);
+                buffer.erase(0, content_length);
+            }
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                counters.requests++;
+                counters.bytes_received += head_end + 4 + content_length;
+            }
+
+            keep_alive = lowercase(headers["connection"]) != "close";
+            if (!handle_request(fd, method, path, headers, body)) break;
+        }
+
+        end:
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            for (size_t i = 0; i < connection_fds.size(); i++)
+            {
+                if (connection_fds[i] == fd)
+                {
+                    connection_fds.erase(connection_fds.begin() + i);
+                    break;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    bool mock_server::handle_request(int fd, const std::string& method,
+        const std::string& path, const std::map<std::string, std::string>& headers,
+        const std::string& body)
+    {
+        // Busy node answers slower, counter is decremented on every return
+        struct in_progress_guard
+        {
+            std::atomic<int>& counter;
+            ~in_progress_guard() { counter--; }
+        } guard{requests_in_progress};
+        int others = requests_in_progress++;
+        bool overloaded = options.max_concurrent > 0 && others >= options.max_concurrent;
+
+        int latency_ms = (overloaded) ? 0 : options.latency_ms + others * options.load_latency_ms;
+        if (options.latency_jitter_ms > 0)
+        {
+            latency_ms += (int)(random_unit() * options.latency_jitter_ms);
+        }
+        if (options.slow_rate > 0 && random_unit() < options.slow_rate)
+        {
+            latency_ms += options.slow_ms;
+        }
+        if (latency_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms));
+
+        if (options.reset_rate > 0 && random_unit() < options.reset_rate)
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            counters.resets++;
+            return false; // Close connection without response
+        }
+
+        std::string response_body;
+        std::string content_type = "text/plain";
+        std::vector<std::string> response_headers;
+        int code;
+
+        auto header = headers.find("content-encoding");
+        std::string decoded_body;
+        bool gzip_body = header != headers.end() && lowercase(header->second) == "gzip";
+        if (gzip_body && !gzip_transform(body, &decoded_body, false))
+        {
+            code = 400;
+            response_body = "Invalid gzip body";
+        }
+        else if (overloaded || (options.error_rate > 0 && random_unit() < options.error_rate))
+        {
+            code = 503;
+            response_body = "Service Unavailable";
+            response_headers.push_back("Retry-After: 1");
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            counters.errors++;
+        }
+        else
+        {
+            code = route(method, path, headers, (gzip_body) ? decoded_body : body,
+                &response_body, &content_type, &response_headers);
+        }
+
+        header = headers.find("accept-encoding");
+        if (options.gzip && code == 200 && response_body.size() >= 1024 &&
+            header != headers.end() && lowercase(header->second).find("gzip") != std::string::npos)
+        {
+            std::string compressed;
+            if (gzip_transform(response_body, &compressed, true))
+            {
+                response_body.swap(compressed);
+                response_headers.push_back("Content-Encoding: gzip");
+                response_headers.push_back("Vary: Accept-Encoding");
+            }
+        }
+
+        const char* reason = "OK";
+        switch (code)
+        {
+            case 201: reason = "Created"; break;
+            case 400: reason = "Bad Request"; break;
+            case 304: reason = "Not Modified"; break;
+            case 404: reason = "Not Found"; break;
+            case 405: reason = "Method Not Allowed"; break;
+            case 500: reason = "Internal Server Error"; break;
+            case 503: reason = "Service Unavailable"; break;
+        }
+
+        std::string response = "HTTP/1.1 " + std::to_string(code) + " " + reason + "\r\n";
+        response += "Content-Type: " + content_type + "\r\n";
+        for (const std::string& header : response_headers) response += header + "\r\n";
+        if (code != 304)
+        {
+            response += "Content-Length: " + std::to_string(response_body.size()) + "\r\n";
+        }
+        response += "\r\n";
+        if (code != 304 && method != "HEAD") response += response_body;
+        return send_all(fd, response.data(), response.size());
+    }
+
+    int mock_server::route(const std::string& method, const std::string& path,
+        const std::map<std::string, std::string>& headers, const std::string& body,
+        std::string* response_body, std::string* content_type,
+        std::vector<std::string>* response_headers)
+    {
+        if (path.compare(0, sizeof(rest_prefix) - 1, rest_prefix) != 0) return 404;
+        std::string resource = path.substr(sizeof(rest_prefix) - 1);
+        resource = resource.substr(0, resource.find('?')); // parameters are ignored
+        std::vector<std::string> seg = split_path(resource);
+
+        // GET layers.{xml,json}, workspaces/{ws}/layers.{xml,json}
+        bool all_layers = seg.size() == 1 &&
+            (seg[0] == "layers.xml" || seg[0] == "layers.json");
+        bool workspace_layers = seg.size() == 3 && seg[0] == "workspaces" &&
+            (seg[2] == "layers.xml" || seg[2] == "layers.json");
+        if (all_layers || workspace_layers)
+        {
+            if (method != "GET") return 405;
+            bool json = ends_with(seg.back(), ".json");
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            std::string etag = "\"catalog-" + std::to_string(catalog_version) + "\"";
+            response_headers->push_back("ETag: " + etag);
+            auto inm = headers.find("if-none-match");
+            if (inm != headers.end() && inm->second == etag)
+            {
+                std::lock_guard<std::mutex> stats_lock(stats_mutex);
+                counters.not_modified++;
+                return 304;
+            }
+            *content_type = (json) ? "application/json" : "application/xml";
+            *response_body = layers_document((workspace_layers) ? &seg[1] : NULL, json);
+            return 200;
+        }
+
+        // POST workspaces/{ws}/datastores/{ds}/featuretypes
+        if (seg.size() == 5 && seg[0] == "workspaces" && seg[2] == "datastores" &&
+            seg[4] == "featuretypes")
+        {
+            if (method != "POST") return 405;
+            std::string name = xml_name(body);
+            if (name.empty()) return 500;
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            if (!layer_keys.insert(seg[1] + ":" + name).second)
+            {
+                *response_body = "Resource named '" + name + "' already exists";
+                return 500;
+            }
+            layers.push_back(catalog_layer{seg[1], name, ""});
+            catalog_version++;
+            *response_body = name;
+            return 201;
+        }
+
+        // DELETE workspaces/{ws}/datastores/{ds}/featuretypes/{layer}
+        if (seg.size() == 6 && seg[0] == "workspaces" && seg[2] == "datastores" &&
+            seg[4] == "featuretypes")
+        {
+            if (method != "DELETE") return 405;
+            std::string key = seg[1] + ":" + seg[5];
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            if (!layer_keys.erase(key))
+            {
+                *response_body = "No such feature type: " + key;
+                return 404;
+            }
+            layers.erase(std::find_if(layers.begin(), layers.end(),
+                [&seg](const catalog_layer& layer)
+                { return layer.workspace == seg[1] && layer.name == seg[5]; }));
+            catalog_version++;
+            return 200;
+        }
+
+        // GET, PUT layers/{ws}:{layer}.xml
+        if (seg.size() == 2 && seg[0] == "layers" && ends_with(seg[1], ".xml"))
+        {
+            if (method != "GET" && method != "PUT") return 405;
+            std::string key = seg[1].substr(0, seg[1].size() - 4);
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            auto layer = std::find_if(layers.begin(), layers.end(),
+                [&key](const catalog_layer& layer)
+                { return key == layer.workspace + ":" + layer.name; });
+            if (!layer_keys.count(key) || layer == layers.end())
+            {
+                *response_body = "No such layer: " + key;
+                return 404;
+            }
+            if (method == "GET")
+            {
+                *content_type = "application/xml";
+                *response_body = "<layer><name>" + layer->name + "</name><type>VECTOR</type>"
+                    "<defaultStyle><name>" +
+                    ((layer->style.empty()) ? "generic" : layer->style) +
+                    "</name></defaultStyle></layer>";
+                return 200;
+            }
+            std::string style = xml_text(body, "defaultStyle");
+            if (!style.empty()) layer->style = xml_name(style);
+            catalog_version++;
+            return 200;
+        }
+
+        // PUT workspaces/{ws}/coveragestores/{cs}/file.geotiff,
+        // workspaces/{ws}/datastores/{ds}/file.shp
+        if (seg.size() == 5 && seg[0] == "workspaces" &&
+            ((seg[2] == "coveragestores" && seg[4] == "file.geotiff") ||
+            (seg[2] == "datastores" && seg[4] == "file.shp")))
+        {
+            if (method != "PUT") return 405;
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            catalog_version++;
+            return 201;
+        }
+
+        // GET workspaces/{ws}/layergroups.xml, POST workspaces/{ws}/layergroups
+        if (seg.size() == 3 && seg[0] == "workspaces" &&
+            (seg[2] == "layergroups" || seg[2] == "layergroups.xml"))
+        {
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            if (method == "GET")
+            {
+                *content_type = "application/xml";
+                *response_body = groups_document(seg[1]);
+                return 200;
+            }
+            if (method != "POST") return 405;
+            std::string name = xml_name(body);
+            catalog_group group;
+            group.title = xml_text(body, "title");
+            if (name.empty() || !parse_group(body, &group.layers, &group.styles)) return 500;
+            if (!groups.emplace(seg[1] + ":" + name, group).second)
+            {
+                *response_body = "Layer group named '" + name + "' already exists";
+                return 500;
+            }
+            catalog_version++;
+            *response_body = name;
+            return 201;
+        }
+
+        // GET, PUT, DELETE workspaces/{ws}/layergroups/{group}[.xml]
+        if (seg.size() == 4 && seg[0] == "workspaces" && seg[2] == "layergroups")
+        {
+            std::string name = seg[3];
+            if (ends_with(name, ".xml")) name.resize(name.size() - 4);
+            std::lock_guard<std::mutex> lock(catalog_mutex);
+            auto group = groups.find(seg[1] + ":" + name);
+            if (group == groups.end())
+            {
+                *response_body = "No such layer group: " + name;
+                return 404;
+            }
+            if (method == "GET")
+            {
+                std::string document = "<layerGroup><name>" + name + "</name><mode>SINGLE</mode>"
+                    "<title>" + group->second.title + "</title><workspace><name>" + seg[1] +
+                    "</name></workspace><publishables>";
+                for (const std::string& layer : group->second.layers)
+                {
+                    document += "<published type=\"layer\"><name>" + layer + "</name></published>";
+                }
+                document += "</publishables><styles>";
+                for (const std::string& style : group->second.styles)
+                {
+                    document += (style.empty()) ? "<style/>" :
+                        "<style><name>" + style + "</name></style>";
+                }
+                *content_type = "application/xml";
+                *response_body = document + "</styles></layerGroup>";
+                return 200;
+            }
+            if (method == "DELETE")
+            {
+                groups.erase(group);
+                catalog_version++;
+                return 200;
+            }
+            if (method != "PUT") return 405;
+            catalog_group updated;
+            updated.title = xml_text(body, "title");
+            if (!parse_group(body, &updated.layers, &updated.styles)) return 500;
+            group->second = updated;
+            catalog_version++;
+            return 200;
+        }
+
+        return 404;
+    }
+
+    // Expects locked "catalog_mutex"
+    std::string mock_server::layers_document(const std::string* workspace, bool json)
+    {
+        if (documents_version != catalog_version)
+        {
+            documents.clear();
+            documents_version = catalog_version;
+        }
+        std::string key = std::string((json) ? "json:" : "xml:") +
+            ((workspace) ? *workspace : "*");
+        auto cached = documents.find(key);
+        if (cached != documents.end()) return cached->second;
+
+        // Same layout as Geoserver, workspace endpoint lists names without workspace
+        std::string document = (json) ? "{\"layers\":{\"layer\":[" : "<layers>\n";
+        bool first = true;
+        for (const catalog_layer& layer : layers)
+        {
+            if (workspace && layer.workspace != *workspace) continue;
+            std::string name = (workspace) ? layer.name : layer.workspace + ":" + layer.name;
+            std::string href = "http://localhost/geoserver/rest/workspaces/" +
+                layer.workspace + "/layers/" + layer.name;
+            if (json)
+            {
+                document += (first) ? "" : ",";
+                document += "{\"name\":\"" + name + "\",\"href\":\"" + href + ".json\"}";
+            }
+            else
+            {
+                document += "  <layer>\n    <name>" + name + "</name>\n"
+                    "    <atom:link xmlns:atom=\"http://www.w3.org/2005/Atom\" "
+                    "rel=\"alternate\" href=\"" + href + ".xml\" type=\"application/xml\"/>\n"
+                    "  </layer>\n";
+            }
+            first = false;
+        }
+        if (json)
+        {
+            document = (first) ? "{\"layers\":\"\"}" : document + "]}}";
+        }
+        else
+        {
+            document += "</layers>";
+        }
+        documents[key] = document;
+        return document;
+    }
+
+    // Expects locked "catalog_mutex"
+    std::string mock_server::groups_document(const std::string& workspace)
+    {
+        std::string document = "<layerGroups>\n";
+        std::string prefix = workspace + ":";
+        for (auto group = groups.lower_bound(prefix);
+            group != groups.end() && group->first.compare(0, prefix.size(), prefix) == 0;
+            ++group)
+        {
+            document += "  <layerGroup>\n    <name>" + group->first.substr(prefix.size()) +
+                "</name>\n  </layerGroup>\n";
+        }
+        return document + "</layerGroups>";
+    }
+
+} // end: namespace geoserver_mock
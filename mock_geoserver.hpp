@@ -0,0 +1,134 @@
+#ifndef MOCK_GEOSERVER_HPP
+#define MOCK_GEOSERVER_HPP
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+/** Local stand-in for Geoserver REST API, used for benchmarks without
+ * network and Geoserver. It emulates only endpoints used by
+ * "geoserver_curl_wrapper":
+ *  - POST workspaces/{ws}/datastores/{ds}/featuretypes
+ *  - DELETE workspaces/{ws}/datastores/{ds}/featuretypes/{layer}
+ *  - GET, PUT layers/{ws}:{layer}.xml
+ *  - GET layers.{xml,json}, workspaces/{ws}/layers.{xml,json}
+ *  - GET, POST workspaces/{ws}/layergroups
+ *  - GET, PUT, DELETE workspaces/{ws}/layergroups/{group}
+ * Server speaks HTTP/1.1 with keep-alive, every connection is served
+ * by own thread. Credentials are not checked.
+ */
+
+namespace geoserver_mock
+{
+    struct mock_options
+    {
+        int port = 0; // 0 to pick free port
+        int latency_ms = 0; // added to every response
+        int latency_jitter_ms = 0; // random extra latency 0..jitter
+        double slow_rate = 0.0; // part of requests delayed by "slow_ms", latency tail
+        int slow_ms = 0;
+        int load_latency_ms = 0; // added for every other request in progress, busy node
+        int max_concurrent = 0; // 503 for requests above it, like control-flow module
+        int num_layers = 100; // initial catalog size
+        int num_workspaces = 4; // initial layers are spread over workspaces
+        double error_rate = 0.0; // part of requests answered with 503
+        double reset_rate = 0.0; // part of requests answered by closing connection
+        bool gzip = true; // compress responses if client accepts gzip, like Geoserver
+        int bandwidth_mbit = 0; // sending speed per connection, 0 - unlimited
+    };
+
+    struct mock_stats
+    {
+        unsigned long requests = 0;
+        unsigned long not_modified = 0; // 304 responses
+        unsigned long errors = 0; // injected 503 responses
+        unsigned long resets = 0; // injected connection resets
+        unsigned long connections = 0;
+        unsigned long bytes_received = 0;
+        unsigned long bytes_sent = 0;
+    };
+
+    class mock_server
+    {
+    public:
+        mock_server() = default;
+        ~mock_server();
+        mock_server(const mock_server&) = delete;
+        mock_server& operator=(const mock_server&) = delete;
+
+        /**
+         * @brief Start listening on 127.0.0.1
+         * 
+         * @returns boolean to indicate wether success or not
+         */
+        bool start(const mock_options& options);
+
+        /**
+         * @brief Close all connections and stop server threads
+         */
+        void stop();
+
+        /**
+         * @brief Port server listens on, useful with "mock_options::port" 0
+         */
+        int port() const;
+
+        mock_stats stats();
+
+    private:
+        struct catalog_layer
+        {
+            std::string workspace;
+            std::string name;
+            std::string style; // default style, empty - generic style
+        };
+
+        struct catalog_group
+        {
+            std::string title;
+            std::vector<std::string> layers; // "{ws}:{layer}"
+            std::vector<std::string> styles; // empty string - default style
+        };
+
+        void accept_loop();
+        void serve_connection(int fd);
+        bool handle_request(int fd, const std::string& method, const std::string& path,
+            const std::map<std::string, std::string>& headers, const std::string& body);
+        int route(const std::string& method, const std::string& path,
+            const std::map<std::string, std::string>& headers, const std::string& body,
+            std::string* response_body, std::string* content_type,
+            std::vector<std::string>* response_headers);
+        std::string layers_document(const std::string* workspace, bool json);
+        std::string groups_document(const std::string& workspace);
+        bool send_all(int fd, const char* data, size_t len);
+
+        mock_options options;
+        int listen_fd = -1;
+        int listen_port = 0;
+        std::atomic<bool> running{false};
+        std::atomic<int> requests_in_progress{0};
+        std::thread accept_thread;
+
+        std::mutex connections_mutex;
+        std::vector<int> connection_fds;
+        std::vector<std::thread> connection_threads;
+
+        std::mutex catalog_mutex;
+        std::vector<catalog_layer> layers;
+        std::set<std::string> layer_keys; // "{ws}:{layer}"
+        std::map<std::string, catalog_group> groups; // "{ws}:{group}"
+        unsigned long catalog_version = 1;
+        std::map<std::string, std::string> documents; // cached layer lists of version
+        unsigned long documents_version = 0;
+
+        std::mutex stats_mutex;
+        mock_stats counters;
+    };
+
+} // end: namespace geoserver_mock
+
+#endif